@@ -0,0 +1,180 @@
+#ifndef ARENA_HH
+#define ARENA_HH
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include "clock.hh"
+#include "voter.hh"
+
+
+ /******************************************************************************
+  arena owning every voter record of a simulation
+  records are stored column by column (struct of arrays) in fixed-size chunks,
+  growing never moves a record and all chunks are freed together when the
+  arena is destroyed, up to MAX_CHUNKS * CHUNK_SIZE (268M) live records, no
+  record is handed out beyond that
+  released records go to a lock-free free list and are handed out again, so
+  a long run only needs as many records as voters are waiting at once
+  *****************************************************************************/
+class VoterArena {
+
+  static const int CHUNK_BITS = 16;
+  static const uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+  static const uint32_t CHUNK_MASK = CHUNK_SIZE - 1;
+  static const int MAX_CHUNKS = 4096;
+
+  struct Chunk {
+    int id[CHUNK_SIZE];
+    int stationId[CHUNK_SIZE];
+    uint8_t type[CHUNK_SIZE];
+    uint16_t vote[CHUNK_SIZE];
+    uint8_t hasVoted[CHUNK_SIZE];
+    simtime_t requestTime[CHUNK_SIZE];
+    simtime_t pollingTime[CHUNK_SIZE];
+    VoterRef nextFree[CHUNK_SIZE];
+  };
+
+  std::atomic<Chunk*> chunks[MAX_CHUNKS];
+  alignas(64) std::atomic<uint32_t> next;
+
+  // free list head, the upper half is a tag bumped on every pop against ABA
+  alignas(64) std::atomic<uint64_t> freeHead;
+  std::atomic<uint32_t> live;
+
+  public:
+    VoterArena() : next(0), freeHead(NO_VOTER), live(0) {
+      for (int i = 0; i < MAX_CHUNKS; i++) {
+        chunks[i].store(NULL, std::memory_order_relaxed);
+      }
+    }
+
+    ~VoterArena() {
+      for (int i = 0; i < MAX_CHUNKS; i++) {
+        delete chunks[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    // a new record, safe to call from any thread, NO_VOTER once every
+    // record is live
+    VoterRef allocate(int id, int stationId, VoterType type, simtime_t requestTime, simtime_t pollingTime) {
+      VoterRef ref = popFree();
+      if (ref == NO_VOTER) {
+        ref = next.load(std::memory_order_relaxed);
+        do {
+          if (ref >= (uint32_t)MAX_CHUNKS << CHUNK_BITS) {
+            return NO_VOTER;
+          }
+        } while (!next.compare_exchange_weak(ref, ref + 1, std::memory_order_relaxed));
+      }
+      live.fetch_add(1, std::memory_order_relaxed);
+      Chunk* chunk = getChunk(ref >> CHUNK_BITS);
+      uint32_t i = ref & CHUNK_MASK;
+      chunk->id[i] = id;
+      chunk->stationId[i] = stationId;
+      chunk->type[i] = (uint8_t)type;
+      chunk->hasVoted[i] = 0;
+      chunk->requestTime[i] = requestTime;
+      chunk->pollingTime[i] = pollingTime;
+      return ref;
+    }
+
+    // hands the record back once nobody refers to it any more
+    void release(VoterRef ref) {
+      Chunk* chunk = at(ref);
+      uint64_t head = freeHead.load(std::memory_order_relaxed);
+      do {
+        chunk->nextFree[ref & CHUNK_MASK] = (VoterRef)head;
+      } while (!freeHead.compare_exchange_weak(head, (head & ~0xFFFFFFFFULL) | ref, std::memory_order_release, std::memory_order_relaxed));
+      live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void castVote(VoterRef ref, Candidate vote, simtime_t now) {
+      Chunk* chunk = at(ref);
+      uint32_t i = ref & CHUNK_MASK;
+      chunk->vote[i] = (uint16_t)vote;
+      chunk->hasVoted[i] = 1;
+      chunk->pollingTime[i] = now;
+    }
+
+    int getId(VoterRef ref) {
+      return at(ref)->id[ref & CHUNK_MASK];
+    }
+
+    int getStationId(VoterRef ref) {
+      return at(ref)->stationId[ref & CHUNK_MASK];
+    }
+
+    VoterType getType(VoterRef ref) {
+      return (VoterType)at(ref)->type[ref & CHUNK_MASK];
+    }
+
+    Candidate getVote(VoterRef ref) {
+      return (Candidate)at(ref)->vote[ref & CHUNK_MASK];
+    }
+
+    bool hasVoted(VoterRef ref) {
+      return at(ref)->hasVoted[ref & CHUNK_MASK];
+    }
+
+    simtime_t getRequestTime(VoterRef ref) {
+      return at(ref)->requestTime[ref & CHUNK_MASK];
+    }
+
+    simtime_t getPollingTime(VoterRef ref) {
+      return at(ref)->pollingTime[ref & CHUNK_MASK];
+    }
+
+    std::string getFormattedId(VoterRef ref) {
+      return std::to_string(getStationId(ref)) + "." + std::to_string(getId(ref));
+    }
+
+    // records in use
+    uint32_t size() {
+      return live.load(std::memory_order_relaxed);
+    }
+
+    // records ever created, the high-water mark of the arena
+    uint32_t capacity() {
+      return next.load(std::memory_order_relaxed);
+    }
+
+    // bytes held by the allocated chunks
+    size_t footprint() {
+      return (size_t)((capacity() + CHUNK_MASK) >> CHUNK_BITS) * sizeof(Chunk);
+    }
+
+  private:
+    VoterRef popFree() {
+      uint64_t head = freeHead.load(std::memory_order_acquire);
+      for (;;) {
+        VoterRef ref = (VoterRef)head;
+        if (ref == NO_VOTER) {
+          return NO_VOTER;
+        }
+        VoterRef following = at(ref)->nextFree[ref & CHUNK_MASK];
+        uint64_t tag = (head >> 32) + 1;
+        if (freeHead.compare_exchange_weak(head, (tag << 32) | following, std::memory_order_acquire, std::memory_order_acquire)) {
+          return ref;
+        }
+      }
+    }
+
+    Chunk* at(VoterRef ref) {
+      return chunks[ref >> CHUNK_BITS].load(std::memory_order_acquire);
+    }
+
+    Chunk* getChunk(uint32_t index) {
+      Chunk* chunk = chunks[index].load(std::memory_order_acquire);
+      if (chunk != NULL) {
+        return chunk;
+      }
+      Chunk* created = new Chunk;
+      if (chunks[index].compare_exchange_strong(chunk, created, std::memory_order_acq_rel)) {
+        return created;
+      }
+      delete created;
+      return chunk;
+    }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "ballot.hh"
+#include <fstream>
+#include <sstream>
+
+Ballot::Ballot() {
+  for (int c = 0; c < NUM_CANDIDATES; c++) {
+    names.push_back(CANDIDATE_NAMES[c]);
+    weights.push_back(CANDIDATE_WEIGHTS[c]);
+  }
+  buildAliasTable();
+}
+
+bool Ballot::load(const std::string& path, std::string& error) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::vector<std::string> loadedNames;
+  std::vector<double> loadedWeights;
+  double total = 0;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    std::istringstream fields(line);
+    std::string name;
+    double weight;
+    if (!(fields >> name)) {
+      continue;
+    }
+    if (!(fields >> weight) || weight < 0) {
+      error = path + ":" + std::to_string(lineNumber) + ": expected <name> <weight>";
+      return false;
+    }
+    if ((int)loadedNames.size() == MAX_CANDIDATES) {
+      error = path + ":" + std::to_string(lineNumber) + ": more than " + std::to_string(MAX_CANDIDATES) + " candidates";
+      return false;
+    }
+    loadedNames.push_back(name);
+    loadedWeights.push_back(weight);
+    total += weight;
+  }
+
+  if (loadedNames.empty() || total <= 0) {
+    error = path + ": no candidate with a positive weight";
+    return false;
+  }
+  names.swap(loadedNames);
+  weights.swap(loadedWeights);
+  buildAliasTable();
+  return true;
+}
+
+// Vose's alias method, every column holds its own candidate with the given
+// probability and the alias otherwise
+void Ballot::buildAliasTable() {
+  int n = weights.size();
+  double total = 0;
+  for (int i = 0; i < n; i++) {
+    total += weights[i];
+  }
+
+  probability.assign(n, 1.0);
+  alias.resize(n);
+  std::vector<double> scaled(n);
+  std::vector<int> small;
+  std::vector<int> large;
+  for (int i = 0; i < n; i++) {
+    alias[i] = i;
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    int less = small.back();
+    int more = large.back();
+    small.pop_back();
+    probability[less] = scaled[less];
+    alias[less] = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  // whatever is left is full up to rounding
+  for (int i = 0; i < (int)small.size(); i++) {
+    probability[small[i]] = 1.0;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef BALLOT_HH
+#define BALLOT_HH
+#include <string>
+#include <vector>
+#include "voter.hh"
+#include "rng.hh"
+
+
+ /******************************************************************************
+  the candidates on the ballot and how likely a voter picks each of them
+  the built-in ballot comes from CANDIDATES_DEF, load() replaces it with a
+  config file of "<name> <weight>" lines, blank lines and # comments ignored
+  votes are drawn from an alias table (Vose), one random number per vote
+  whatever the number of candidates
+  a Candidate is an index into the ballot
+  *****************************************************************************/
+
+// votes are kept in 16 bits, in the voter arena and in the voter log
+const int MAX_CANDIDATES = 65535;
+
+class Ballot {
+  std::vector<std::string> names;
+  std::vector<double> weights;
+
+  // alias table
+  std::vector<double> probability;
+  std::vector<int> alias;
+
+  public:
+    // the built-in ballot
+    Ballot();
+
+    // returns false and keeps the current ballot if the file is unusable,
+    // error then says why
+    bool load(const std::string& path, std::string& error);
+
+    Candidate draw(Rng& rng) const {
+      double u = rng.uniform() * alias.size();
+      int i = (int)u;
+      return (Candidate)(u - i < probability[i] ? i : alias[i]);
+    }
+
+    const char* getName(Candidate candidate) const {
+      return names[(int)candidate].c_str();
+    }
+
+    double getWeight(Candidate candidate) const {
+      return weights[(int)candidate];
+    }
+
+    int size() const {
+      return names.size();
+    }
+
+  private:
+    void buildAliasTable();
+};
+
+#endif
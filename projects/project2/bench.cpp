@@ -0,0 +1,700 @@
+#include "clock.hh"
+#include "voter.hh"
+#include "arena.hh"
+#include "queue.hh"
+#include "dispatch.hh"
+#include "discipline.hh"
+#include "histogram.hh"
+#include "logger.hh"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <queue>
+#include <map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+ /******************************************************************************
+  microbenchmarks of the hot paths of the simulator
+  every benchmark reports rows of throughput and latency percentiles, as csv
+  or json, so a run can be kept as a baseline and later runs compared to it
+  latencies are sampled, one operation in LATENCY_SAMPLE is timed on its own
+  and the clock read is part of what is measured
+  *****************************************************************************/
+
+// operations between two timed ones
+const int LATENCY_SAMPLE = 16;
+
+// one row of the report, latencies in nanoseconds
+struct BenchResult {
+  std::string benchmark;
+  std::string variant;
+  long parameter = 0;
+  long operations = 0;
+  // operations per second
+  double throughput = 0;
+  // false when the benchmark has no per operation latency
+  bool timed = false;
+  double mean = 0;
+  simtime_t p50 = 0;
+  simtime_t p90 = 0;
+  simtime_t p99 = 0;
+  simtime_t p999 = 0;
+};
+
+void setLatencies(BenchResult& result, LatencyHistogram& latencies) {
+  result.timed = latencies.count() > 0;
+  result.mean = latencies.mean();
+  result.p50 = latencies.percentile(0.5);
+  result.p90 = latencies.percentile(0.9);
+  result.p99 = latencies.percentile(0.99);
+  result.p999 = latencies.percentile(0.999);
+}
+
+// merges the histograms of the threads of a run and frees them
+void mergeLatencies(std::vector<LatencyHistogram*>& perThread, LatencyHistogram& latencies) {
+  for (size_t i = 0; i < perThread.size(); i++) {
+    latencies.merge(*perThread[i]);
+    delete perThread[i];
+  }
+  perThread.clear();
+}
+
+ /******************************************************************************
+  throughput of the station queue under contention
+  each run starts n producers and n consumers on a single queue, with every
+  discipline a station can have, or the mutex queue it replaced, producers
+  enqueue a fixed number of voters and consumers drain them, the latency is
+  that of one enqueue or one dequeue, waits for a full queue included
+  *****************************************************************************/
+
+// the mutex-guarded priority queue that PollingQueue replaced, kept as baseline
+class VoterComparator {
+  VoterArena* arena;
+
+  public:
+    VoterComparator(VoterArena* arena) : arena(arena) {}
+
+    bool operator() (VoterRef v1, VoterRef v2) {
+        return arena->getType(v1) < arena->getType(v2);
+    }
+};
+
+class LockedPollingQueue {
+  VoterArena* arena;
+  std::priority_queue<VoterRef, std::vector<VoterRef>, VoterComparator> voters;
+  std::mutex mtx;
+  int counter = 0;
+
+  public:
+    LockedPollingQueue(VoterArena* arena)
+      : arena(arena), voters(VoterComparator(arena)) {
+
+    }
+
+    VoterRef enqueue(VoterType type, int stationId, simtime_t now, simtime_t deadline) {
+      std::lock_guard<std::mutex> lock(mtx);
+      VoterRef voter = arena->allocate(counter++, stationId, type, now, deadline);
+      if (voter != NO_VOTER) {
+        voters.push(voter);
+      }
+      return voter;
+    }
+
+    VoterRef tryDequeue() {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (voters.empty()) {
+        return NO_VOTER;
+      }
+      VoterRef voter = voters.top();
+      voters.pop();
+      return voter;
+    }
+};
+
+// a station queue with the discipline of the mode, as the simulation sets it
+void makeQueue(VoterArena* arena, const std::string& mode, PollingQueue*& queue) {
+  queue = new PollingQueue(arena, 1 << 16);
+  queue->setDiscipline(makeDiscipline(mode, NSEC_PER_SEC));
+}
+
+void makeQueue(VoterArena* arena, const std::string&, LockedPollingQueue*& queue) {
+  queue = new LockedPollingQueue(arena);
+}
+
+template <typename Queue>
+BenchResult benchQueue(const std::string& variant, int threads, int operations) {
+  VoterArena* arena = new VoterArena();
+  Queue* queue;
+  makeQueue(arena, variant, queue);
+  std::atomic<int> consumed(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  std::vector<LatencyHistogram*> perThread;
+  int perProducer = operations / threads;
+  int total = perProducer * threads;
+
+  for (int i = 0; i < threads; i++) {
+    LatencyHistogram* produced = new LatencyHistogram();
+    LatencyHistogram* taken = new LatencyHistogram();
+    perThread.push_back(produced);
+    perThread.push_back(taken);
+    workers.push_back(std::thread([&, i, produced]() {
+      while (!go.load()) {}
+      for (int j = 0; j < perProducer; j++) {
+        VoterType type = (j % 3 == 0) ? VoterType::Special : VoterType::Ordinary;
+        simtime_t before = j % LATENCY_SAMPLE == 0 ? monotonic_now() : 0;
+        while (queue->enqueue(type, i, 0, 0) == NO_VOTER) {
+          std::this_thread::yield();
+        }
+        if (before != 0) {
+          produced->record(monotonic_now() - before);
+        }
+      }
+    }));
+    workers.push_back(std::thread([&, taken]() {
+      while (!go.load()) {}
+      int j = 0;
+      while (consumed.load(std::memory_order_relaxed) < total) {
+        // only dequeues that found a voter are timed
+        simtime_t before = j % LATENCY_SAMPLE == 0 ? monotonic_now() : 0;
+        if (queue->tryDequeue() == NO_VOTER) {
+          std::this_thread::yield();
+          continue;
+        }
+        if (before != 0) {
+          taken->record(monotonic_now() - before);
+        }
+        j++;
+        consumed.fetch_add(1, std::memory_order_relaxed);
+      }
+    }));
+  }
+
+  simtime_t start = monotonic_now();
+  go.store(true);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  simtime_t elapsed = monotonic_now() - start;
+  delete queue;
+  delete arena;
+
+  // enqueues plus dequeues per second
+  BenchResult result;
+  result.benchmark = "queue";
+  result.variant = variant;
+  result.parameter = threads;
+  result.operations = 2L * total;
+  result.throughput = 2.0 * total / ns_to_seconds(elapsed);
+  LatencyHistogram latencies;
+  mergeLatencies(perThread, latencies);
+  setLatencies(result, latencies);
+  return result;
+}
+
+// n producers and n consumers for n up to maxThreads
+void benchQueues(int operations, int maxThreads, std::vector<BenchResult>& results) {
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    const char* MODES[] = { "strict", "fifo", "aging", "wfq" };
+    for (int m = 0; m < 4; m++) {
+      results.push_back(benchQueue<PollingQueue>(MODES[m], threads, operations));
+    }
+    results.push_back(benchQueue<LockedPollingQueue>("mutex", threads, operations));
+  }
+}
+
+ /******************************************************************************
+  cost of dispatching one arrival as the number of stations grows
+  every arrival selects a queue, joins it and the dispatcher is updated, then
+  a random station serves one voter so queue lengths keep changing
+  the served runs do the same with stations serving on n threads of their
+  own, every dequeue updating the dispatcher too, as in a threaded run
+  *****************************************************************************/
+
+// the queues with up to three voters each
+void fillQueues(VoterArena* arena, int stations, std::vector<PollingQueue*>& queues, unsigned long long& state) {
+  for (int i = 0; i < stations; i++) {
+    queues.push_back(new PollingQueue(arena, 64));
+  }
+  for (int i = 0; i < stations; i++) {
+    state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+    for (int j = 0; j < (int)(state % 4); j++) {
+      queues[i]->enqueue(VoterType::Ordinary, i, 0, 0);
+    }
+  }
+}
+
+BenchResult benchDispatcher(const std::string& mode, int stations, int operations) {
+  VoterArena* arena = new VoterArena();
+  std::vector<PollingQueue*> queues;
+  unsigned long long state = 88172645463325252ULL;
+  fillQueues(arena, stations, queues, state);
+  Dispatcher* dispatcher = makeDispatcher(mode, queues, 1, 0);
+  LatencyHistogram latencies;
+
+  simtime_t start = monotonic_now();
+  for (int i = 0; i < operations; i++) {
+    simtime_t before = i % LATENCY_SAMPLE == 0 ? monotonic_now() : 0;
+    int slot = dispatcher->select();
+    if (queues[slot]->enqueue(VoterType::Ordinary, slot, 0, 0) != NO_VOTER) {
+      dispatcher->update(slot);
+    }
+    if (before != 0) {
+      latencies.record(monotonic_now() - before);
+    }
+    state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+    int served = state % stations;
+    if (queues[served]->tryDequeue() != NO_VOTER) {
+      dispatcher->update(served);
+    }
+  }
+  simtime_t elapsed = monotonic_now() - start;
+
+  delete dispatcher;
+  for (int i = 0; i < stations; i++) {
+    delete queues[i];
+  }
+  delete arena;
+
+  // arrivals per second, the latency is that of one arrival
+  BenchResult result;
+  result.benchmark = "dispatch";
+  result.variant = mode;
+  result.parameter = stations;
+  result.operations = operations;
+  result.throughput = operations / ns_to_seconds(elapsed);
+  setLatencies(result, latencies);
+  return result;
+}
+
+BenchResult benchServedDispatcher(const std::string& mode, int stations, int servers, int operations) {
+  VoterArena* arena = new VoterArena();
+  std::vector<PollingQueue*> queues;
+  unsigned long long state = 88172645463325252ULL;
+  fillQueues(arena, stations, queues, state);
+  Dispatcher* dispatcher = makeDispatcher(mode, queues, 1, 0);
+  LatencyHistogram latencies;
+  std::atomic<bool> go(false);
+  std::atomic<bool> done(false);
+
+  // server s serves every servers-th station from s
+  std::vector<std::thread> workers;
+  for (int s = 0; s < servers; s++) {
+    workers.push_back(std::thread([&, s]() {
+      while (!go.load()) {}
+      while (!done.load(std::memory_order_relaxed)) {
+        bool served = false;
+        for (int slot = s; slot < stations; slot += servers) {
+          if (queues[slot]->tryDequeue() != NO_VOTER) {
+            dispatcher->update(slot);
+            served = true;
+          }
+        }
+        if (!served) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+
+  simtime_t start = monotonic_now();
+  go.store(true);
+  for (int i = 0; i < operations; i++) {
+    simtime_t before = i % LATENCY_SAMPLE == 0 ? monotonic_now() : 0;
+    int slot = dispatcher->select();
+    if (queues[slot]->enqueue(VoterType::Ordinary, slot, 0, 0) != NO_VOTER) {
+      dispatcher->update(slot);
+    }
+    if (before != 0) {
+      latencies.record(monotonic_now() - before);
+    }
+  }
+  simtime_t elapsed = monotonic_now() - start;
+  done.store(true);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+
+  delete dispatcher;
+  for (int i = 0; i < stations; i++) {
+    delete queues[i];
+  }
+  delete arena;
+
+  BenchResult result;
+  result.benchmark = "dispatch-served";
+  result.variant = mode;
+  result.parameter = servers;
+  result.operations = operations;
+  result.throughput = operations / ns_to_seconds(elapsed);
+  setLatencies(result, latencies);
+  return result;
+}
+
+void benchDispatchers(int operations, int maxThreads, std::vector<BenchResult>& results) {
+  const char* MODES[] = { "scan", "heap", "p2c" };
+  for (int stations = 10; stations <= 100000; stations *= 10) {
+    // keep the linear scan from dominating the run time at large station counts
+    int ops = std::max(1000, std::min(operations, 200000000 / stations));
+    for (int m = 0; m < 3; m++) {
+      results.push_back(benchDispatcher(MODES[m], stations, ops));
+    }
+  }
+  const int SERVED_STATIONS = 1000;
+  int ops = std::max(1000, std::min(operations, 200000000 / SERVED_STATIONS));
+  for (int servers = 1; servers <= std::min(maxThreads, 8); servers *= 2) {
+    for (int m = 0; m < 3; m++) {
+      results.push_back(benchServedDispatcher(MODES[m], SERVED_STATIONS, servers, ops));
+    }
+  }
+}
+
+ /******************************************************************************
+  throughput of the console logger
+  n threads log votes, or lines formatted by the caller, as fast as they can
+  with stdout sent to /dev/null, verbose lines are not dropped, so a thread
+  waits whenever its ring is full and the rate is what the drain thread
+  sustains, the run ends once everything is written
+  the mutex variant is the baseline the logger replaced, every thread
+  formats its vote and writes it to std::cout under one global mutex
+  *****************************************************************************/
+
+std::mutex print_mtx;
+void lockedVote(int station, int voter, const char* name, int count) {
+  std::lock_guard<std::mutex> lock(print_mtx);
+  std::cout << "Polling Station " << station << ": Voter " << voter << " voted for " << name << " (" << count << ")" << std::endl;
+}
+
+BenchResult benchLogger(const std::string& variant, int threads, int operations) {
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  close(null);
+
+  bool locked = variant == "mutex";
+  Logger* logger = NULL;
+  if (!locked) {
+    logger = new Logger();
+    logger->start(50, false);
+  }
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  std::vector<LatencyHistogram*> perThread;
+  int perThreadOps = operations / threads;
+  bool votes = variant == "vote";
+  for (int i = 0; i < threads; i++) {
+    LatencyHistogram* latencies = new LatencyHistogram();
+    perThread.push_back(latencies);
+    workers.push_back(std::thread([&, i, latencies]() {
+      std::string line = "Polling Station " + std::to_string(i) + ": Polling station opened";
+      while (!go.load()) {}
+      for (int j = 0; j < perThreadOps; j++) {
+        simtime_t before = j % LATENCY_SAMPLE == 0 ? monotonic_now() : 0;
+        if (locked) {
+          lockedVote(i, j, "Mickey Mouse", j);
+        } else if (votes) {
+          logger->vote(i, j, "Mickey Mouse", j);
+        } else {
+          logger->print(line);
+        }
+        if (before != 0) {
+          latencies->record(monotonic_now() - before);
+        }
+      }
+    }));
+  }
+
+  simtime_t start = monotonic_now();
+  go.store(true);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  if (logger != NULL) {
+    logger->flush();
+  }
+  simtime_t elapsed = monotonic_now() - start;
+  delete logger;
+
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  // lines per second
+  BenchResult result;
+  result.benchmark = "log";
+  result.variant = variant;
+  result.parameter = threads;
+  result.operations = (long)perThreadOps * threads;
+  result.throughput = result.operations / ns_to_seconds(elapsed);
+  LatencyHistogram latencies;
+  mergeLatencies(perThread, latencies);
+  setLatencies(result, latencies);
+  return result;
+}
+
+void benchLoggers(int operations, int maxThreads, std::vector<BenchResult>& results) {
+  for (int threads = 1; threads <= std::min(maxThreads, 8); threads *= 2) {
+    results.push_back(benchLogger("mutex", threads, operations));
+    results.push_back(benchLogger("vote", threads, operations));
+    results.push_back(benchLogger("print", threads, operations));
+  }
+}
+
+ /******************************************************************************
+  voters per second of whole virtual-time runs
+  the simulation binary runs a sweep over station counts in batch mode on a
+  single worker, every run has about the same number of voters and its
+  votes over its wall clock time is the row, there are no per voter latencies
+  the run parameters are fixed so reports of different builds compare
+  *****************************************************************************/
+void benchSimulations(const std::string& simulation, int operations, std::vector<BenchResult>& results) {
+  char path[] = "/tmp/bench-sweep-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    std::cerr << "bench: cannot create a sweep file" << std::endl;
+    return;
+  }
+  // a generator brings one voter per tick, so every run sees as many voters
+  // and only the stations they are spread over change
+  std::ostringstream sweep;
+  // every station costs some work each tick whether anyone comes or not,
+  // beyond a thousand of them that is all a run measures
+  for (int stations = 10; stations <= 1000; stations *= 10) {
+    int ticks = std::max(60, operations / 16);
+    sweep << "-c " << stations << " -T " << ticks << " -s 1" << std::endl;
+  }
+  std::string lines = sweep.str();
+  bool written = write(fd, lines.data(), lines.size()) == (ssize_t)lines.size();
+  close(fd);
+
+  std::string command = simulation + " -B " + path + " -w 1 -g 1 -p 0.5 -f 0.2 2>/dev/null";
+  FILE* pipe = written ? popen(command.c_str(), "r") : NULL;
+  std::vector<std::vector<std::string> > rows;
+  if (pipe != NULL) {
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
+      std::vector<std::string> fields;
+      std::istringstream line(buffer);
+      std::string field;
+      while (std::getline(line, field, ',')) {
+        fields.push_back(field);
+      }
+      rows.push_back(fields);
+    }
+    pclose(pipe);
+  }
+  unlink(path);
+
+  // columns by name from the header line of the summary
+  std::map<std::string, int> columns;
+  for (int i = 0; !rows.empty() && i < (int)rows[0].size(); i++) {
+    std::string name = rows[0][i];
+    name.erase(name.find_last_not_of("\r\n") + 1);
+    columns[name] = i;
+  }
+  if (columns.count("c") == 0 || columns.count("votes") == 0 || columns.count("elapsed") == 0) {
+    std::cerr << "bench: no batch summary from " << simulation << std::endl;
+    return;
+  }
+  for (size_t r = 1; r < rows.size(); r++) {
+    if ((int)rows[r].size() <= columns["elapsed"]) {
+      continue;
+    }
+    BenchResult result;
+    result.benchmark = "simulation";
+    result.variant = "virtual";
+    result.parameter = atol(rows[r][columns["c"]].c_str());
+    result.operations = atol(rows[r][columns["votes"]].c_str());
+    double elapsed = atof(rows[r][columns["elapsed"]].c_str());
+    result.throughput = elapsed > 0 ? result.operations / elapsed : 0;
+    results.push_back(result);
+  }
+}
+
+ /******************************************************************************
+  reports and baselines
+  *****************************************************************************/
+void writeResults(std::ostream& out, const std::vector<BenchResult>& results, bool json) {
+  const char* NAMES[] = {
+    "benchmark", "variant", "parameter", "operations", "throughput",
+    "mean_ns", "p50_ns", "p90_ns", "p99_ns", "p999_ns"
+  };
+  const int COLUMNS = 10;
+
+  if (json) {
+    out << "[" << std::endl;
+  } else {
+    for (int i = 0; i < COLUMNS; i++) {
+      out << (i > 0 ? "," : "") << NAMES[i];
+    }
+    out << std::endl;
+  }
+
+  for (size_t r = 0; r < results.size(); r++) {
+    const BenchResult& result = results[r];
+    std::vector<std::string> fields;
+    fields.push_back(json ? "\"" + result.benchmark + "\"" : result.benchmark);
+    fields.push_back(json ? "\"" + result.variant + "\"" : result.variant);
+    fields.push_back(std::to_string(result.parameter));
+    fields.push_back(std::to_string(result.operations));
+    std::ostringstream number;
+    number << std::fixed << std::setprecision(1) << result.throughput;
+    fields.push_back(number.str());
+    number.str("");
+    number << std::fixed << std::setprecision(1) << result.mean;
+    // rows without latencies leave them empty, null in json
+    std::string none = json ? "null" : "";
+    fields.push_back(result.timed ? number.str() : none);
+    fields.push_back(result.timed ? std::to_string(result.p50) : none);
+    fields.push_back(result.timed ? std::to_string(result.p90) : none);
+    fields.push_back(result.timed ? std::to_string(result.p99) : none);
+    fields.push_back(result.timed ? std::to_string(result.p999) : none);
+
+    if (json) {
+      out << "  {";
+      for (int i = 0; i < COLUMNS; i++) {
+        out << (i > 0 ? ", " : "") << "\"" << NAMES[i] << "\": " << fields[i];
+      }
+      out << "}" << (r + 1 < results.size() ? "," : "") << std::endl;
+    } else {
+      for (int i = 0; i < COLUMNS; i++) {
+        out << (i > 0 ? "," : "") << fields[i];
+      }
+      out << std::endl;
+    }
+  }
+
+  if (json) {
+    out << "]" << std::endl;
+  }
+}
+
+// compares the throughput of every row with the row of the same benchmark,
+// variant and parameter in a csv report of an earlier run, returns the
+// number of rows that lost more than tolerance percent, or -1 if the
+// baseline cannot be read
+int compareResults(const std::string& path, const std::vector<BenchResult>& results, double tolerance) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    std::cerr << "bench: cannot open " << path << std::endl;
+    return -1;
+  }
+  std::map<std::string, double> baseline;
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields;
+    std::istringstream row(line);
+    std::string field;
+    while (std::getline(row, field, ',')) {
+      fields.push_back(field);
+    }
+    if (fields.size() >= 5) {
+      baseline[fields[0] + " " + fields[1] + " " + fields[2]] = atof(fields[4].c_str());
+    }
+  }
+
+  int regressions = 0;
+  for (size_t r = 0; r < results.size(); r++) {
+    const BenchResult& result = results[r];
+    std::string key = result.benchmark + " " + result.variant + " " + std::to_string(result.parameter);
+    std::map<std::string, double>::iterator found = baseline.find(key);
+    if (found == baseline.end() || found->second <= 0) {
+      continue;
+    }
+    double change = 100 * (result.throughput - found->second) / found->second;
+    if (change < -tolerance) {
+      std::cerr << std::fixed << std::setprecision(1);
+      std::cerr << "bench: " << key << " regressed " << -change << "%, " << result.throughput << " ops/s against " << found->second << std::endl;
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+void print_usage() {
+  std::cout << "usage: bench [-o <operations>] [-b queue|dispatch|log|simulation|all] [-t <max_threads>] [-S <simulation>] [-J] [-r <baseline_csv> [-x <percent>]]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+  // benchmark parameters
+  int OPERATIONS = 1 << 20;
+  std::string BENCHMARK = "all";
+  int MAX_THREADS = 64;
+  std::string SIMULATION = "./simulation";
+  bool JSON = false;
+  std::string BASELINE_PATH;
+  double TOLERANCE = 10;
+
+  // parse command line arguments
+  int c;
+  while ((c = getopt(argc, argv, "o:b:t:S:Jr:x:")) != -1) {
+    switch (c) {
+    case 'o':
+      OPERATIONS = atoi(optarg);
+      break;
+    case 'b':
+      BENCHMARK = optarg;
+      break;
+    case 't':
+      MAX_THREADS = atoi(optarg);
+      break;
+    case 'S':
+      SIMULATION = optarg;
+      break;
+    case 'J':
+      JSON = true;
+      break;
+    case 'r':
+      BASELINE_PATH = optarg;
+      break;
+    case 'x':
+      TOLERANCE = atof(optarg);
+      break;
+    default:
+      print_usage();
+      return 0;
+    }
+  }
+  if (OPERATIONS < 1 || MAX_THREADS < 1 || TOLERANCE < 0) {
+    print_usage();
+    return 0;
+  }
+
+  std::vector<BenchResult> results;
+  if (BENCHMARK == "all" || BENCHMARK == "queue") {
+    benchQueues(OPERATIONS, MAX_THREADS, results);
+  }
+  if (BENCHMARK == "all" || BENCHMARK == "dispatch") {
+    benchDispatchers(OPERATIONS, MAX_THREADS, results);
+  }
+  if (BENCHMARK == "all" || BENCHMARK == "log") {
+    benchLoggers(OPERATIONS, MAX_THREADS, results);
+  }
+  if (BENCHMARK == "all" || BENCHMARK == "simulation") {
+    benchSimulations(SIMULATION, OPERATIONS, results);
+  }
+  writeResults(std::cout, results, JSON);
+
+  // a regression fails the run, so scripts can gate on it
+  if (!BASELINE_PATH.empty()) {
+    int regressions = compareResults(BASELINE_PATH, results, TOLERANCE);
+    if (regressions != 0) {
+      return 1;
+    }
+  }
+
+}
@@ -0,0 +1,93 @@
+#include "binlog.hh"
+#include <chrono>
+
+// how long buffered records may wait for a full buffer before being flushed
+static const int FLUSH_INTERVAL_MS = 200;
+
+VoterLogWriter::VoterLogWriter(size_t capacity) : capacity(capacity) {
+  buffers[0].reserve(capacity);
+  buffers[1].reserve(capacity);
+}
+
+VoterLogWriter::~VoterLogWriter() {
+  close();
+}
+
+bool VoterLogWriter::open(const char* path, const VoterLogHeader& header) {
+  file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  stopping = false;
+  pthread_create(&thread, NULL, &VoterLogWriter::writerThread, this);
+  return true;
+}
+
+void VoterLogWriter::append(const VoterRecord& record) {
+  append(&record, 1);
+}
+
+void VoterLogWriter::append(const VoterRecord* records, int n) {
+  std::unique_lock<std::mutex> lock(mtx);
+  for (int i = 0; i < n; i++) {
+    while (buffers[front].size() >= capacity) {
+      if (!backFull) {
+        front = 1 - front;
+        backFull = true;
+        writerCond.notify_one();
+      } else {
+        producerCond.wait(lock);
+      }
+    }
+    buffers[front].push_back(records[i]);
+  }
+}
+
+void VoterLogWriter::close() {
+  if (file == NULL) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+    writerCond.notify_one();
+  }
+  pthread_join(thread, NULL);
+  fclose(file);
+  file = NULL;
+}
+
+void* VoterLogWriter::writerThread(void* arg) {
+  static_cast<VoterLogWriter*>(arg)->run();
+  return NULL;
+}
+
+void VoterLogWriter::run() {
+  std::unique_lock<std::mutex> lock(mtx);
+  for (;;) {
+    if (!backFull && !stopping) {
+      writerCond.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+    }
+    // flush a partially filled front buffer on timeouts and at the end
+    if (!backFull && !buffers[front].empty()) {
+      front = 1 - front;
+      backFull = true;
+    }
+    if (!backFull) {
+      if (stopping) {
+        break;
+      }
+      continue;
+    }
+    std::vector<VoterRecord>& back = buffers[1 - front];
+    lock.unlock();
+    fwrite(back.data(), sizeof(VoterRecord), back.size(), file);
+    lock.lock();
+    written += back.size();
+    back.clear();
+    backFull = false;
+    producerCond.notify_all();
+  }
+  fflush(file);
+}
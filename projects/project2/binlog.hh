@@ -0,0 +1,95 @@
+#ifndef BINLOG_HH
+#define BINLOG_HH
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "clock.hh"
+
+
+ /******************************************************************************
+  streaming binary voter log
+  a header followed by one fixed-size record per voter, written as voters
+  finish instead of at the end of the run, render it with logview
+  stations append into the front buffer, a writer thread drains the back
+  buffer to the file, the two are swapped whenever the front one fills up
+  *****************************************************************************/
+
+const char VOTER_LOG_MAGIC[4] = { 'V', 'L', 'O', 'G' };
+const uint32_t VOTER_LOG_VERSION = 3;
+
+struct VoterLogHeader {
+  char magic[4];
+  uint32_t version;
+  // tick of the run, decides how many decimals the rendered log shows
+  int64_t tick;
+  // station slices of the arrival generators, used to restore arrival order
+  int32_t stations;
+  int32_t generators;
+  // whether every station opened with two voters, ids 0 and 1
+  uint8_t seeded;
+  // decimals of the times in the log, finer than the tick when a replayed
+  // trace has arrivals between ticks
+  uint8_t precision;
+  uint8_t reserved[6];
+};
+
+// times are nanoseconds since the start of the simulation
+struct VoterRecord {
+  int32_t stationId;
+  int32_t id;
+  uint8_t type;
+  uint8_t hasVoted;
+  uint16_t vote;
+  uint8_t reserved[4];
+  int64_t requestTime;
+  int64_t pollingTime;
+};
+
+static_assert(sizeof(VoterLogHeader) == 32, "voter log header must stay 32 bytes");
+static_assert(sizeof(VoterRecord) == 32, "voter records must stay 32 bytes");
+
+class VoterLogWriter {
+  FILE* file = NULL;
+  size_t capacity;
+
+  // double buffer
+  std::vector<VoterRecord> buffers[2];
+  int front = 0;
+  bool backFull = false;
+  bool stopping = false;
+  long written = 0;
+
+  std::mutex mtx;
+  std::condition_variable writerCond;
+  std::condition_variable producerCond;
+  pthread_t thread;
+
+  public:
+    VoterLogWriter(size_t capacity = 4096);
+    ~VoterLogWriter();
+
+    // returns false if the file cannot be created
+    bool open(const char* path, const VoterLogHeader& header);
+
+    // safe to call from any thread, blocks only while both buffers are full
+    void append(const VoterRecord& record);
+
+    // appends n records under a single lock
+    void append(const VoterRecord* records, int n);
+
+    // writes what is buffered and closes the file
+    void close();
+
+    long getWritten() {
+      return written;
+    }
+
+  private:
+    static void* writerThread(void* arg);
+    void run();
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CLOCK_HH
+#define CLOCK_HH
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+
+ /******************************************************************************
+  simulation time is kept in nanoseconds, on the monotonic clock in the
+  threaded mode and on a virtual clock starting at zero in the virtual mode
+  *****************************************************************************/
+typedef int64_t simtime_t;
+
+const simtime_t NSEC_PER_SEC = 1000000000LL;
+
+// current monotonic time in nanoseconds
+inline simtime_t monotonic_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (simtime_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+inline simtime_t seconds_to_ns(double seconds) {
+  return (simtime_t)llround(seconds * NSEC_PER_SEC);
+}
+
+inline double ns_to_seconds(simtime_t ns) {
+  return (double)ns / NSEC_PER_SEC;
+}
+
+// decimal places needed to print multiples of tick in seconds, 0 to 9
+inline int tick_precision(simtime_t tick) {
+  int precision = 0;
+  simtime_t unit = NSEC_PER_SEC;
+  while (precision < 9 && tick % unit != 0) {
+    unit /= 10;
+    precision++;
+  }
+  return precision;
+}
+
+#endif
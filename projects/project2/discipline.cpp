@@ -0,0 +1,88 @@
+#include "discipline.hh"
+#include <algorithm>
+
+int ArrivalOrder::pick(const QueueHead* heads) {
+  int type = -1;
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    if (heads[t].waiting && (type < 0 || heads[t].sequence - heads[type].sequence < 0)) {
+      type = t;
+    }
+  }
+  return type;
+}
+
+// ties go to the higher type
+int AgingPriority::pick(const QueueHead* heads) {
+  int type = -1;
+  simtime_t best = 0;
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    simtime_t score = heads[t].request - t * credit;
+    if (heads[t].waiting && (type < 0 || score <= best)) {
+      type = t;
+      best = score;
+    }
+  }
+  return type;
+}
+
+WeightedFair::WeightedFair() : current(0) {
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    pass[t].store(0, std::memory_order_relaxed);
+  }
+}
+
+// ties go to the higher type
+int WeightedFair::pick(const QueueHead* heads) {
+  int64_t now = current.load(std::memory_order_relaxed);
+  int type = -1;
+  int64_t best = 0;
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    int64_t start = std::max(pass[t].load(std::memory_order_relaxed), now);
+    if (heads[t].waiting && (type < 0 || start <= best)) {
+      type = t;
+      best = start;
+    }
+  }
+  return type;
+}
+
+void WeightedFair::taken(int type) {
+  int64_t start = std::max(pass[type].load(std::memory_order_relaxed), current.load(std::memory_order_relaxed));
+  current.store(start, std::memory_order_relaxed);
+  pass[type].store(start + (STRIDE >> type), std::memory_order_relaxed);
+}
+
+std::vector<int64_t> WeightedFair::getState() {
+  std::vector<int64_t> state;
+  state.push_back(current.load(std::memory_order_relaxed));
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    state.push_back(pass[t].load(std::memory_order_relaxed));
+  }
+  return state;
+}
+
+// a state of another discipline is ignored
+void WeightedFair::setState(const std::vector<int64_t>& state) {
+  if (state.size() != NUM_VOTER_TYPES + 1) {
+    return;
+  }
+  current.store(state[0], std::memory_order_relaxed);
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    pass[t].store(state[t + 1], std::memory_order_relaxed);
+  }
+}
+
+bool isDisciplineMode(const std::string& mode) {
+  return mode == "strict" || mode == "fifo" || mode == "aging" || mode == "wfq";
+}
+
+QueueDiscipline* makeDiscipline(const std::string& mode, simtime_t tick) {
+  if (mode == "fifo") {
+    return new ArrivalOrder();
+  } else if (mode == "aging") {
+    return new AgingPriority(tick);
+  } else if (mode == "wfq") {
+    return new WeightedFair();
+  }
+  return NULL;
+}
@@ -0,0 +1,98 @@
+#ifndef DISCIPLINE_HH
+#define DISCIPLINE_HH
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "clock.hh"
+#include "voter.hh"
+
+
+ /******************************************************************************
+  queue disciplines decide which voter type a station serves next
+  a station queue keeps every type in arrival order, so the discipline only
+  looks at the oldest waiting voter of each type and names the type, the
+  queue then takes that voter
+    strict  higher types first, ordinary voters wait as long as special
+            voters keep coming, the queue serves it without a discipline
+            and without a lock
+    fifo    arrival order at the station whatever the type, by the sequence
+            number the queue gives every voter
+    aging   a voter counts as having arrived AGING_TICKS earlier for every
+            type below its own, so a waiting voter is served before any
+            higher type voter that came more than that much later
+    wfq     weighted fair queueing, every type gets a share of the booth in
+            proportion to its weight, 1, 2, 4, ... from the lowest type up
+  every station has a discipline of its own
+  *****************************************************************************/
+
+// ticks an aging voter gains for each type below its own
+const int AGING_TICKS = 10;
+
+// the oldest waiting voter of a type
+struct QueueHead {
+  bool waiting;
+  int sequence;
+  simtime_t request;
+};
+
+class QueueDiscipline {
+  public:
+    virtual ~QueueDiscipline() {}
+
+    // the type to serve next, heads holds one entry per type and at least
+    // one type is waiting, the queue calls pick and taken from one thread
+    // at a time
+    virtual int pick(const QueueHead* heads) = 0;
+
+    // a voter of the type left the queue
+    virtual void taken(int) {}
+
+    // state carried from one pick to the next, for snapshots
+    virtual std::vector<int64_t> getState() {
+      return std::vector<int64_t>();
+    }
+
+    virtual void setState(const std::vector<int64_t>&) {}
+};
+
+class ArrivalOrder : public QueueDiscipline {
+  public:
+    int pick(const QueueHead* heads);
+};
+
+class AgingPriority : public QueueDiscipline {
+  simtime_t credit;
+
+  public:
+    AgingPriority(simtime_t tick) : credit(AGING_TICKS * tick) {}
+    int pick(const QueueHead* heads);
+};
+
+// start-time fair queueing over the types, every type has a virtual pass
+// that grows by the inverse of its weight with every voter served, the
+// waiting type with the lowest pass goes next, a pass never counts as lower
+// than that of the last voter served, so a type gets no credit for the
+// time it had nobody waiting, the passes are atomics only so a snapshot
+// may read them, every update happens under the lock of the queue
+class WeightedFair : public QueueDiscipline {
+  static const int64_t STRIDE = 1 << 20;
+
+  std::atomic<int64_t> pass[NUM_VOTER_TYPES];
+  std::atomic<int64_t> current;
+
+  public:
+    WeightedFair();
+    int pick(const QueueHead* heads);
+    void taken(int type);
+    std::vector<int64_t> getState();
+    void setState(const std::vector<int64_t>& state);
+};
+
+bool isDisciplineMode(const std::string& mode);
+
+// a discipline for one station queue, NULL for strict, which the queue
+// serves by itself, and for an unknown mode
+QueueDiscipline* makeDiscipline(const std::string& mode, simtime_t tick);
+
+#endif
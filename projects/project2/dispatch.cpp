@@ -0,0 +1,215 @@
+#include "dispatch.hh"
+
+void Dispatcher::save(SnapshotWriter& out) {
+  for (int i = 0; i < (int)queues.size(); i++) {
+    out.put((uint8_t)isDown(i));
+  }
+}
+
+void Dispatcher::load(SnapshotReader& in) {
+  for (int i = 0; i < (int)queues.size(); i++) {
+    down[i].store(in.get<uint8_t>() != 0, std::memory_order_relaxed);
+  }
+}
+
+int ScanDispatcher::select() {
+  int slot = 0;
+  bool slotDown = isDown(0);
+  int shortest = queues[0]->size();
+  for (int i = 1; i < (int)queues.size(); i++) {
+    bool iDown = isDown(i);
+    if (iDown && !slotDown) {
+      continue;
+    }
+    int length = queues[i]->size();
+    if (length < shortest || slotDown != iDown) {
+      slot = i;
+      slotDown = iDown;
+      shortest = length;
+    }
+  }
+  return slot;
+}
+
+HeapDispatcher::HeapDispatcher(const std::vector<PollingQueue*>& queues)
+  : Dispatcher(queues),
+    heap(queues.size()),
+    position(queues.size()),
+    length(queues.size()),
+    stale(queues.size()),
+    staleSlots(queues.size())
+{
+  for (int i = 0; i < (int)queues.size(); i++) {
+    heap[i] = i;
+    position[i] = i;
+    length[i] = queues[i]->size();
+    stale[i].store(false, std::memory_order_relaxed);
+  }
+  for (int i = (int)heap.size() / 2 - 1; i >= 0; i--) {
+    siftDown(i);
+  }
+}
+
+int HeapDispatcher::select() {
+  std::lock_guard<std::mutex> lock(mtx);
+  int slot;
+  while (staleSlots.pop(slot)) {
+    // cleared before the length is read, so a change after the read marks
+    // the slot again
+    stale[slot].store(false, std::memory_order_seq_cst);
+    rekey(slot);
+  }
+  return heap[0];
+}
+
+// a slot is in the ring at most once, so the ring never fills up
+void HeapDispatcher::update(int slot) {
+  if (!stale[slot].exchange(true, std::memory_order_seq_cst)) {
+    staleSlots.push(slot);
+  }
+}
+
+// with mtx held
+void HeapDispatcher::rekey(int slot) {
+  int current = queues[slot]->size();
+  if (current == length[slot]) {
+    return;
+  }
+  bool grew = current > length[slot];
+  length[slot] = current;
+  if (grew) {
+    siftDown(position[slot]);
+  } else {
+    siftUp(position[slot]);
+  }
+}
+
+void HeapDispatcher::setDown(int slot, bool isDown) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (down[slot].load(std::memory_order_relaxed) == isDown) {
+    return;
+  }
+  down[slot].store(isDown, std::memory_order_relaxed);
+  if (isDown) {
+    siftDown(position[slot]);
+  } else {
+    siftUp(position[slot]);
+  }
+}
+
+void HeapDispatcher::load(SnapshotReader& in) {
+  Dispatcher::load(in);
+  std::lock_guard<std::mutex> lock(mtx);
+  for (int i = 0; i < (int)queues.size(); i++) {
+    length[i] = queues[i]->size();
+  }
+  for (int i = (int)heap.size() / 2 - 1; i >= 0; i--) {
+    siftDown(i);
+  }
+}
+
+bool HeapDispatcher::less(int i, int j) {
+  int a = heap[i];
+  int b = heap[j];
+  bool downA = isDown(a);
+  bool downB = isDown(b);
+  if (downA != downB) {
+    return downB;
+  }
+  if (length[a] != length[b]) {
+    return length[a] < length[b];
+  }
+  return a < b;
+}
+
+void HeapDispatcher::swap(int i, int j) {
+  std::swap(heap[i], heap[j]);
+  position[heap[i]] = i;
+  position[heap[j]] = j;
+}
+
+void HeapDispatcher::siftUp(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!less(i, parent)) {
+      break;
+    }
+    swap(i, parent);
+    i = parent;
+  }
+}
+
+void HeapDispatcher::siftDown(int i) {
+  int n = heap.size();
+  for (;;) {
+    int smallest = i;
+    int left = 2 * i + 1;
+    int right = left + 1;
+    if (left < n && less(left, smallest)) {
+      smallest = left;
+    }
+    if (right < n && less(right, smallest)) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      break;
+    }
+    swap(i, smallest);
+    i = smallest;
+  }
+}
+
+TwoChoiceDispatcher::TwoChoiceDispatcher(const std::vector<PollingQueue*>& queues, unsigned seed, int stream)
+  : Dispatcher(queues),
+    rng(seed, RngStream::Dispatch, stream)
+{
+
+}
+
+int TwoChoiceDispatcher::select() {
+  int n = queues.size();
+  if (n == 1) {
+    return 0;
+  }
+  int a = rng.below(n);
+  int b = rng.below(n - 1);
+  if (b >= a) {
+    b++;
+  }
+  bool downA = isDown(a);
+  bool downB = isDown(b);
+  if (downA != downB) {
+    return downA ? b : a;
+  }
+  int la = queues[a]->size();
+  int lb = queues[b]->size();
+  if (la != lb) {
+    return la < lb ? a : b;
+  }
+  return a < b ? a : b;
+}
+
+void TwoChoiceDispatcher::save(SnapshotWriter& out) {
+  Dispatcher::save(out);
+  out.put(rng.getState());
+}
+
+void TwoChoiceDispatcher::load(SnapshotReader& in) {
+  Dispatcher::load(in);
+  rng.setState(in.get<uint64_t>());
+}
+
+bool isDispatchMode(const std::string& mode) {
+  return mode == "scan" || mode == "heap" || mode == "p2c";
+}
+
+Dispatcher* makeDispatcher(const std::string& mode, const std::vector<PollingQueue*>& queues, unsigned seed, int stream) {
+  if (mode == "scan") {
+    return new ScanDispatcher(queues);
+  } else if (mode == "heap") {
+    return new HeapDispatcher(queues);
+  } else if (mode == "p2c") {
+    return new TwoChoiceDispatcher(queues, seed, stream);
+  }
+  return NULL;
+}
@@ -0,0 +1,113 @@
+#ifndef DISPATCH_HH
+#define DISPATCH_HH
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "queue.hh"
+#include "rng.hh"
+
+
+ /******************************************************************************
+  dispatchers pick the station queue an arriving voter joins
+  queues are addressed by their slot in the vector the dispatcher was built
+  with, stations call update() whenever their queue length changes
+  a station under repair marks its slot down and takes no voters as long as
+  another station of the dispatcher is up
+  *****************************************************************************/
+class Dispatcher {
+  protected:
+    std::vector<PollingQueue*> queues;
+    std::vector<std::atomic<bool>> down;
+
+  public:
+    Dispatcher(const std::vector<PollingQueue*>& queues) : queues(queues), down(queues.size()) {
+      for (int i = 0; i < (int)queues.size(); i++) {
+        down[i].store(false, std::memory_order_relaxed);
+      }
+    }
+    virtual ~Dispatcher() {}
+
+    // slot of the queue the next voter should join
+    virtual int select() = 0;
+
+    // queue length of this slot changed
+    virtual void update(int) {}
+
+    // the station of this slot stopped or resumed taking voters
+    virtual void setDown(int slot, bool isDown) {
+      down[slot].store(isDown, std::memory_order_relaxed);
+    }
+
+    bool isDown(int slot) {
+      return down[slot].load(std::memory_order_relaxed);
+    }
+
+    // the slots that are down and any state of the selection itself
+    virtual void save(SnapshotWriter& out);
+    virtual void load(SnapshotReader& in);
+
+    int size() {
+      return queues.size();
+    }
+};
+
+// linear scan for the shortest queue of a station that is up, ties go to
+// the lowest slot
+class ScanDispatcher : public Dispatcher {
+  public:
+    ScanDispatcher(const std::vector<PollingQueue*>& queues) : Dispatcher(queues) {}
+    int select();
+};
+
+// indexed min-heap keyed by (down, queue length, slot)
+// update() takes no lock, it only marks the slot stale, once, in a lock-free
+// ring, select() rekeys the stale slots under the lock before it reads the
+// top, so station threads never wait for each other and the arrival still
+// joins the shortest queue as of the moment it is dispatched, bench -b
+// dispatch compares it to scan with stations serving on other threads
+class HeapDispatcher : public Dispatcher {
+  std::vector<int> heap;
+  std::vector<int> position;
+  std::vector<int> length;
+  std::mutex mtx;
+  std::vector<std::atomic<bool>> stale;
+  MPMCRing<int> staleSlots;
+
+  public:
+    HeapDispatcher(const std::vector<PollingQueue*>& queues);
+    int select();
+    void update(int slot);
+    void setDown(int slot, bool isDown);
+
+    // rebuilt from the queue lengths
+    void load(SnapshotReader& in);
+
+  private:
+    bool less(int i, int j);
+    void swap(int i, int j);
+    void rekey(int slot);
+    void siftUp(int i);
+    void siftDown(int i);
+};
+
+// shorter of two randomly sampled queues, a station that is up wins over
+// one that is down
+class TwoChoiceDispatcher : public Dispatcher {
+  Rng rng;
+
+  public:
+    TwoChoiceDispatcher(const std::vector<PollingQueue*>& queues, unsigned seed, int stream);
+    int select();
+    void save(SnapshotWriter& out);
+    void load(SnapshotReader& in);
+};
+
+// true for the names accepted by the -d flag
+bool isDispatchMode(const std::string& mode);
+
+// builds the dispatcher named by the -d flag, NULL if the name is unknown
+// randomized dispatchers draw from the given stream of the seed
+Dispatcher* makeDispatcher(const std::string& mode, const std::vector<PollingQueue*>& queues, unsigned seed, int stream);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef EVENTS_HH
+#define EVENTS_HH
+#include "clock.hh"
+#include "snapshot.hh"
+#include <queue>
+#include <vector>
+
+
+ /******************************************************************************
+  discrete-event scheduling for the virtual-time simulation mode
+  events are ordered by timestamp, ties are broken by insertion order so a run
+  with a fixed seed always processes events in the same order
+  *****************************************************************************/
+
+// kinds of events processed by the simulation
+// a wakeup tells an idle station that a voter joined its queue
+// a failure breaks the machine of a station, see failure.hh
+// exports and checkpoints are timers of the simulation itself, see timer.hh
+// a replay feeds the arrivals of a trace due at its time, see trace.hh
+// a progress report sums up the shards of a sharded run, see shard.hh
+enum class EventType { Arrival, CastComplete, Failure, Repair, Wakeup, Export, Checkpoint, Replay, Progress };
+
+// a timestamped event, the target is the station it happens at or the
+// arrival generator for arrivals
+struct Event {
+  simtime_t time;
+  unsigned long seq;
+  EventType type;
+  int target;
+};
+
+class EventComparator {
+  public:
+    bool operator() (const Event& e1, const Event& e2) {
+      if (e1.time != e2.time) {
+        return e1.time > e2.time;
+      }
+      return e1.seq > e2.seq;
+    }
+};
+
+// anything events can be scheduled on
+class Scheduler {
+  public:
+    virtual ~Scheduler() {}
+    virtual void push(simtime_t time, EventType type, int target) = 0;
+};
+
+// anything that processes events, now is the time the event is handled at
+class EventHandler {
+  public:
+    virtual ~EventHandler() {}
+    virtual void handle(const Event& event, simtime_t now, Scheduler& scheduler) = 0;
+};
+
+class EventQueue : public Scheduler {
+  std::priority_queue<Event, std::vector<Event>, EventComparator> events;
+  unsigned long counter = 0;
+
+  public:
+    void push(simtime_t time, EventType type, int target) {
+      Event event;
+      event.time = time;
+      event.seq = counter++;
+      event.type = type;
+      event.target = target;
+      events.push(event);
+    }
+
+    Event pop() {
+      Event event = events.top();
+      events.pop();
+      return event;
+    }
+
+    const Event& top() {
+      return events.top();
+    }
+
+    bool empty() {
+      return events.empty();
+    }
+
+    int size() {
+      return events.size();
+    }
+
+    // the pending events with their insertion order
+    void save(SnapshotWriter& out) {
+      std::priority_queue<Event, std::vector<Event>, EventComparator> copy = events;
+      out.put((uint64_t)counter);
+      out.put((int64_t)copy.size());
+      while (!copy.empty()) {
+        out.put(copy.top());
+        copy.pop();
+      }
+    }
+
+    // only into an empty queue
+    void load(SnapshotReader& in) {
+      counter = in.get<uint64_t>();
+      int64_t n = in.get<int64_t>();
+      for (int64_t i = 0; i < n && in.good(); i++) {
+        events.push(in.get<Event>());
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "failure.hh"
+#include <math.h>
+
+// a drawn time in nanoseconds, cut before the cast so it cannot overflow
+static simtime_t toDelay(double ns) {
+  return ns < (double)MAX_FAILURE_DELAY ? (simtime_t)ns : MAX_FAILURE_DELAY;
+}
+
+simtime_t PeriodicFailures::next(Rng& rng) const {
+  if (rate <= 0) {
+    return -1;
+  }
+  if (rate >= 1) {
+    return interval;
+  }
+  // checks until the first failed one, drawn at once
+  double checks = floor(log(1.0 - rng.uniform()) / log(1.0 - rate)) + 1;
+  return toDelay(checks * interval);
+}
+
+simtime_t ExponentialFailures::next(Rng& rng) const {
+  if (rate <= 0) {
+    return -1;
+  }
+  return toDelay(-log(1.0 - rng.uniform()) * interval / rate);
+}
+
+bool isFailureMode(const std::string& mode) {
+  return mode == "periodic" || mode == "exp";
+}
+
+FailureModel* makeFailureModel(const std::string& mode, double rate, simtime_t interval) {
+  if (mode == "periodic") {
+    return new PeriodicFailures(rate, interval);
+  } else if (mode == "exp") {
+    return new ExponentialFailures(rate, interval);
+  }
+  return NULL;
+}
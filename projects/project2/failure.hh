@@ -0,0 +1,55 @@
+#ifndef FAILURE_HH
+#define FAILURE_HH
+#include <string>
+#include "clock.hh"
+#include "rng.hh"
+
+
+ /******************************************************************************
+  failure models, when the machine of a station breaks down next
+  a station draws the time to its next failure when it opens and whenever it
+  comes back from repair, and schedules the failure as an event, so nothing
+  is polled while the station runs
+  rate is the -f flag, the chance of failing per check interval
+    periodic  the machine is checked every interval and fails a check with
+              probability rate, the legacy model
+    exp       failures arrive as a poisson process at rate failures per
+              interval, a machine fails at any moment
+  *****************************************************************************/
+
+// longest time to a failure, draws beyond it are cut to it, far past the end
+// of any run and still safe to add to a clock reading
+const simtime_t MAX_FAILURE_DELAY = INT64_MAX / 2;
+
+class FailureModel {
+  protected:
+    double rate;
+    simtime_t interval;
+
+  public:
+    FailureModel(double rate, simtime_t interval) : rate(rate), interval(interval) {}
+    virtual ~FailureModel() {}
+
+    // time from now to the next failure, negative if the machine never fails
+    virtual simtime_t next(Rng& rng) const = 0;
+};
+
+class PeriodicFailures : public FailureModel {
+  public:
+    PeriodicFailures(double rate, simtime_t interval) : FailureModel(rate, interval) {}
+    simtime_t next(Rng& rng) const;
+};
+
+class ExponentialFailures : public FailureModel {
+  public:
+    ExponentialFailures(double rate, simtime_t interval) : FailureModel(rate, interval) {}
+    simtime_t next(Rng& rng) const;
+};
+
+// true for the names accepted by the -F flag
+bool isFailureMode(const std::string& mode);
+
+// builds the failure model named by the -F flag, NULL if the name is unknown
+FailureModel* makeFailureModel(const std::string& mode, double rate, simtime_t interval);
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef HISTOGRAM_HH
+#define HISTOGRAM_HH
+#include <stdint.h>
+#include <math.h>
+#include <atomic>
+#include "clock.hh"
+#include "snapshot.hh"
+
+
+ /******************************************************************************
+  latency histograms in the style of HdrHistogram
+  buckets are linear within every power of two (log-linear), 128 per octave,
+  so a reported value is off by less than 0.4% of itself at any scale
+  an octave's counters are only allocated once a value falls into it, a
+  histogram of a station that only ever sees latencies of a few seconds
+  holds a handful of pages
+  a histogram has a single writer, recording is a few plain loads and
+  stores, any thread may read or merge it while it is being written
+  values from 0 up to 2^45 ns (about 9.7 hours) are told apart, larger
+  values land in the top bucket
+  *****************************************************************************/
+
+// what is measured for every voter
+enum class LatencyMetric { Wait, Service, Turnaround };
+const int NUM_LATENCY_METRICS = 3;
+
+inline const char* getLatencyMetricName(LatencyMetric metric) {
+  if (metric == LatencyMetric::Wait) {
+    return "wait";
+  } else if (metric == LatencyMetric::Service) {
+    return "service";
+  } else {
+    return "turnaround";
+  }
+}
+
+class LatencyHistogram {
+
+  static const int SUB_BITS = 7;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
+  static const int PAGES = 39;
+
+  std::atomic<std::atomic<uint32_t>*> pages[PAGES];
+  std::atomic<long> total;
+  std::atomic<simtime_t> sum;
+  std::atomic<simtime_t> min;
+  std::atomic<simtime_t> max;
+
+  public:
+    LatencyHistogram() : total(0), sum(0), min(0), max(0) {
+      for (int p = 0; p < PAGES; p++) {
+        pages[p].store(NULL, std::memory_order_relaxed);
+      }
+    }
+
+    ~LatencyHistogram() {
+      for (int p = 0; p < PAGES; p++) {
+        delete[] pages[p].load(std::memory_order_relaxed);
+      }
+    }
+
+    void record(simtime_t value) {
+      value = value < 0 ? 0 : value;
+      add(value, 1, value, value, value);
+    }
+
+    // adds the values of another histogram, which may still be written to
+    void merge(LatencyHistogram& other) {
+      long count = other.count();
+      if (count == 0) {
+        return;
+      }
+      for (int p = 0; p < PAGES; p++) {
+        std::atomic<uint32_t>* counts = other.pages[p].load(std::memory_order_acquire);
+        if (counts == NULL) {
+          continue;
+        }
+        for (int s = 0; s < SUB_BUCKETS; s++) {
+          uint32_t n = counts[s].load(std::memory_order_relaxed);
+          if (n > 0) {
+            bump(p, s, n);
+          }
+        }
+      }
+      add(-1, count, other.sum.load(std::memory_order_relaxed), other.min.load(std::memory_order_relaxed), other.max.load(std::memory_order_relaxed));
+    }
+
+    long count() {
+      return total.load(std::memory_order_relaxed);
+    }
+
+    double mean() {
+      long n = count();
+      return n > 0 ? (double)sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    simtime_t getMin() {
+      return min.load(std::memory_order_relaxed);
+    }
+
+    simtime_t getMax() {
+      return max.load(std::memory_order_relaxed);
+    }
+
+    // the value below which the fraction of the values falls, as the middle
+    // of its bucket
+    simtime_t percentile(double fraction) {
+      long n = count();
+      if (n == 0) {
+        return 0;
+      }
+      long rank = (long)ceil(fraction * n);
+      rank = rank < 1 ? 1 : rank;
+      long seen = 0;
+      for (int p = 0; p < PAGES; p++) {
+        std::atomic<uint32_t>* counts = pages[p].load(std::memory_order_acquire);
+        if (counts == NULL) {
+          continue;
+        }
+        for (int s = 0; s < SUB_BUCKETS; s++) {
+          seen += counts[s].load(std::memory_order_relaxed);
+          if (seen >= rank) {
+            simtime_t value = lowest(p, s) + width(p) / 2;
+            return value < getMin() ? getMin() : (value > getMax() ? getMax() : value);
+          }
+        }
+      }
+      return getMax();
+    }
+
+    // the totals and the buckets that counted anything
+    void save(SnapshotWriter& out) {
+      out.put(total.load(std::memory_order_relaxed));
+      out.put(sum.load(std::memory_order_relaxed));
+      out.put(min.load(std::memory_order_relaxed));
+      out.put(max.load(std::memory_order_relaxed));
+      int32_t buckets = 0;
+      for (int p = 0; p < PAGES; p++) {
+        std::atomic<uint32_t>* counts = pages[p].load(std::memory_order_relaxed);
+        for (int s = 0; counts != NULL && s < SUB_BUCKETS; s++) {
+          buckets += counts[s].load(std::memory_order_relaxed) > 0;
+        }
+      }
+      out.put(buckets);
+      for (int p = 0; p < PAGES; p++) {
+        std::atomic<uint32_t>* counts = pages[p].load(std::memory_order_relaxed);
+        for (int s = 0; counts != NULL && s < SUB_BUCKETS; s++) {
+          uint32_t n = counts[s].load(std::memory_order_relaxed);
+          if (n > 0) {
+            out.put((uint8_t)p);
+            out.put((uint8_t)s);
+            out.put(n);
+          }
+        }
+      }
+    }
+
+    // only into an empty histogram
+    void load(SnapshotReader& in) {
+      long count = in.get<long>();
+      simtime_t valueSum = in.get<simtime_t>();
+      simtime_t valueMin = in.get<simtime_t>();
+      simtime_t valueMax = in.get<simtime_t>();
+      int32_t buckets = in.get<int32_t>();
+      for (int i = 0; i < buckets && in.good(); i++) {
+        int p = in.get<uint8_t>();
+        int s = in.get<uint8_t>();
+        uint32_t n = in.get<uint32_t>();
+        if (p < PAGES && s < SUB_BUCKETS) {
+          bump(p, s, n);
+        }
+      }
+      if (count > 0) {
+        add(-1, count, valueSum, valueMin, valueMax);
+      }
+    }
+
+  private:
+    // counts value into its bucket, or only the totals if value is negative
+    void add(simtime_t value, long count, simtime_t valueSum, simtime_t valueMin, simtime_t valueMax) {
+      if (value >= 0) {
+        int page;
+        int slot;
+        locate(value, page, slot);
+        bump(page, slot, 1);
+      }
+      long before = total.load(std::memory_order_relaxed);
+      if (before == 0 || valueMin < min.load(std::memory_order_relaxed)) {
+        min.store(valueMin, std::memory_order_relaxed);
+      }
+      if (before == 0 || valueMax > max.load(std::memory_order_relaxed)) {
+        max.store(valueMax, std::memory_order_relaxed);
+      }
+      sum.store(sum.load(std::memory_order_relaxed) + valueSum, std::memory_order_relaxed);
+      total.store(before + count, std::memory_order_relaxed);
+    }
+
+    void bump(int page, int slot, uint32_t n) {
+      std::atomic<uint32_t>* counts = pages[page].load(std::memory_order_relaxed);
+      if (counts == NULL) {
+        counts = new std::atomic<uint32_t>[SUB_BUCKETS];
+        for (int s = 0; s < SUB_BUCKETS; s++) {
+          counts[s].store(0, std::memory_order_relaxed);
+        }
+        pages[page].store(counts, std::memory_order_release);
+      }
+      counts[slot].store(counts[slot].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // page 0 holds 0 to 127 one by one, page p > 0 holds [2^(p+6), 2^(p+7))
+    static void locate(simtime_t value, int& page, int& slot) {
+      if (value < SUB_BUCKETS) {
+        page = 0;
+        slot = (int)value;
+        return;
+      }
+      int msb = 63 - __builtin_clzll((unsigned long long)value);
+      page = msb - SUB_BITS + 1;
+      if (page >= PAGES) {
+        page = PAGES - 1;
+        slot = SUB_BUCKETS - 1;
+        return;
+      }
+      slot = (int)(value >> (page - 1)) - SUB_BUCKETS;
+    }
+
+    static simtime_t lowest(int page, int slot) {
+      return page == 0 ? slot : (simtime_t)(SUB_BUCKETS + slot) << (page - 1);
+    }
+
+    static simtime_t width(int page) {
+      return page == 0 ? 1 : (simtime_t)1 << (page - 1);
+    }
+};
+
+// the histograms of one kind of voter at one station
+struct LatencySet {
+  LatencyHistogram metrics[NUM_LATENCY_METRICS];
+
+  void save(SnapshotWriter& out) {
+    for (int m = 0; m < NUM_LATENCY_METRICS; m++) {
+      metrics[m].save(out);
+    }
+  }
+
+  void load(SnapshotReader& in) {
+    for (int m = 0; m < NUM_LATENCY_METRICS; m++) {
+      metrics[m].load(in);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,277 @@
+#include "logger.hh"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <sched.h>
+
+// kinds of log entries
+static const uint8_t LOG_LINE = 0;
+static const uint8_t LOG_STATION = 1;
+static const uint8_t LOG_VOTE = 2;
+
+static const size_t MAX_LINE = sizeof(((LogEntry*)0)->text) * LOG_MAX_LINE_ENTRIES;
+
+// the ring of the calling thread, registered with the logger on first use
+static thread_local Logger* ringOwner = NULL;
+static thread_local void* ownRing = NULL;
+
+// serializes direct writes outside start() and stop()
+static std::mutex directMtx;
+
+static void appendInt(std::string& out, int64_t value) {
+  char buf[24];
+  int i = sizeof(buf);
+  bool negative = value < 0;
+  uint64_t v = negative ? -(uint64_t)value : (uint64_t)value;
+  do {
+    buf[--i] = '0' + (v % 10);
+    v /= 10;
+  } while (v != 0);
+  if (negative) {
+    buf[--i] = '-';
+  }
+  out.append(buf + i, sizeof(buf) - i);
+}
+
+Logger::Logger() : running(false) {}
+
+Logger::~Logger() {
+  stop();
+  for (int i = 0; i < (int)rings.size(); i++) {
+    delete rings[i];
+  }
+}
+
+void Logger::start(int flushInterval, bool dropVerbose) {
+  if (running) {
+    return;
+  }
+  this->flushInterval = flushInterval > 0 ? flushInterval : 1;
+  this->dropVerbose = dropVerbose;
+  stopping = false;
+  running = true;
+  pthread_create(&thread, NULL, &Logger::drainThread, this);
+}
+
+void Logger::stop() {
+  if (!running) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+    drainCond.notify_one();
+  }
+  pthread_join(thread, NULL);
+  running = false;
+  long dropped = getDropped();
+  if (dropped > 0) {
+    print("[Log] Dropped " + std::to_string(dropped) + " verbose lines");
+  }
+}
+
+void Logger::flush() {
+  if (!running) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mtx);
+  unsigned long id = ++flushRequested;
+  drainCond.notify_one();
+  while (flushDone < id) {
+    flushCond.wait(lock);
+  }
+}
+
+void Logger::print(const std::string& line) {
+  LogEntry entry;
+  entry.kind = LOG_LINE;
+  push(entry, line.data(), line.size(), LogLevel::Info);
+}
+
+void Logger::station(int station, const std::string& message) {
+  LogEntry entry;
+  entry.kind = LOG_STATION;
+  entry.station = station;
+  push(entry, message.data(), message.size(), LogLevel::Info);
+}
+
+void Logger::vote(int station, long voter, const char* name, long count) {
+  LogEntry entry;
+  entry.kind = LOG_VOTE;
+  entry.station = station;
+  entry.voter = voter;
+  entry.count = count;
+  entry.name = name;
+  push(entry, NULL, 0, LogLevel::Verbose);
+}
+
+long Logger::getDropped() {
+  std::lock_guard<std::mutex> lock(ringsMtx);
+  long dropped = 0;
+  for (int i = 0; i < (int)rings.size(); i++) {
+    dropped += rings[i]->dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
+
+void Logger::push(LogEntry& entry, const char* text, size_t length, LogLevel level) {
+  const size_t TEXT = sizeof(entry.text);
+  length = std::min(length, MAX_LINE);
+  uint32_t needed = length == 0 ? 1 : (length + TEXT - 1) / TEXT;
+
+  if (!running) {
+    std::vector<LogEntry> entries(needed, entry);
+    for (uint32_t i = 0; i < needed; i++) {
+      size_t offset = i * TEXT;
+      entries[i].length = std::min(TEXT, length - std::min(length, offset));
+      if (entries[i].length > 0) {
+        memcpy(entries[i].text, text + offset, entries[i].length);
+      }
+    }
+    std::string out;
+    format(entries.data(), needed, out);
+    std::lock_guard<std::mutex> lock(directMtx);
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    return;
+  }
+
+  Ring* ring = getRing();
+  uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+  while (tail - ring->head.load(std::memory_order_acquire) + needed > Ring::CAPACITY) {
+    if (level == LogLevel::Verbose && dropVerbose) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    drainCond.notify_one();
+    sched_yield();
+  }
+
+  simtime_t stamp = monotonic_now();
+  for (uint32_t i = 0; i < needed; i++) {
+    uint32_t slot = (tail + i) & (Ring::CAPACITY - 1);
+    LogEntry& target = ring->entries[slot];
+    size_t offset = i * TEXT;
+    target = entry;
+    target.more = i + 1 < needed;
+    target.length = length > offset ? std::min(TEXT, length - offset) : 0;
+    if (target.length > 0) {
+      memcpy(target.text, text + offset, target.length);
+    }
+    ring->stamps[slot] = stamp;
+  }
+  // a line is published as a whole
+  ring->tail.store(tail + needed, std::memory_order_release);
+}
+
+Logger::Ring* Logger::getRing() {
+  if (ringOwner == this) {
+    return static_cast<Ring*>(ownRing);
+  }
+  Ring* ring = new Ring();
+  {
+    std::lock_guard<std::mutex> lock(ringsMtx);
+    rings.push_back(ring);
+  }
+  ringOwner = this;
+  ownRing = ring;
+  return ring;
+}
+
+void* Logger::drainThread(void* arg) {
+  static_cast<Logger*>(arg)->run();
+  return NULL;
+}
+
+void Logger::run() {
+  std::string out;
+  std::unique_lock<std::mutex> lock(mtx);
+  for (;;) {
+    bool stop = stopping;
+    unsigned long requested = flushRequested;
+    lock.unlock();
+    if (drain(out) > 0) {
+      fwrite(out.data(), 1, out.size(), stdout);
+      fflush(stdout);
+      out.clear();
+    }
+    lock.lock();
+    flushDone = requested;
+    flushCond.notify_all();
+    if (stop) {
+      break;
+    }
+    if (!stopping && flushRequested == requested) {
+      drainCond.wait_for(lock, std::chrono::milliseconds(flushInterval));
+    }
+  }
+}
+
+// formats everything published so far, merging the rings by timestamp
+size_t Logger::drain(std::string& out) {
+  std::vector<Ring*> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(ringsMtx);
+    snapshot = rings;
+  }
+  int n = snapshot.size();
+  std::vector<uint32_t> heads(n);
+  std::vector<uint32_t> tails(n);
+  for (int i = 0; i < n; i++) {
+    heads[i] = snapshot[i]->head.load(std::memory_order_relaxed);
+    tails[i] = snapshot[i]->tail.load(std::memory_order_acquire);
+  }
+
+  size_t lines = 0;
+  LogEntry line[LOG_MAX_LINE_ENTRIES];
+  for (;;) {
+    int next = -1;
+    simtime_t earliest = 0;
+    for (int i = 0; i < n; i++) {
+      if (heads[i] == tails[i]) {
+        continue;
+      }
+      simtime_t stamp = snapshot[i]->stamps[heads[i] & (Ring::CAPACITY - 1)];
+      if (next < 0 || stamp < earliest) {
+        next = i;
+        earliest = stamp;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    Ring* ring = snapshot[next];
+    int count = 0;
+    do {
+      line[count] = ring->entries[heads[next] & (Ring::CAPACITY - 1)];
+      heads[next]++;
+    } while (line[count++].more);
+    ring->head.store(heads[next], std::memory_order_release);
+    format(line, count, out);
+    lines++;
+  }
+  return lines;
+}
+
+void Logger::format(const LogEntry* entries, int count, std::string& out) {
+  const LogEntry& first = entries[0];
+  if (first.kind != LOG_LINE) {
+    out.append("Polling Station ");
+    appendInt(out, first.station);
+    out.append(": ");
+  }
+  if (first.kind == LOG_VOTE) {
+    out.append("Voter ");
+    appendInt(out, first.voter);
+    out.append(" voted for ");
+    out.append(first.name);
+    out.append(" (");
+    appendInt(out, first.count);
+    out.append(")");
+  } else {
+    for (int i = 0; i < count; i++) {
+      out.append(entries[i].text, entries[i].length);
+    }
+  }
+  out.push_back('\n');
+}
@@ -0,0 +1,109 @@
+#ifndef LOGGER_HH
+#define LOGGER_HH
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include "clock.hh"
+
+
+ /******************************************************************************
+  asynchronous console logger
+  every thread writes into its own single-producer ring, so logging never takes
+  a lock, one drain thread formats the entries, merges the rings by timestamp
+  and writes them out, flushing stdout once per flush interval
+  integer fields are stored as they are and only formatted by the drain thread
+  with drop mode, verbose lines are dropped when a ring is full instead of
+  making the thread wait for the drain thread to catch up
+  before start() and after stop() lines are written directly
+  *****************************************************************************/
+
+enum class LogLevel { Info, Verbose };
+
+// one slot of a ring, a line longer than its text continues in the next slots
+struct LogEntry {
+  uint8_t kind;
+  uint8_t more;
+  uint16_t length;
+  int32_t station;
+  int64_t voter;
+  int64_t count;
+  const char* name;
+  char text[32];
+};
+
+static_assert(sizeof(LogEntry) == 64, "log entries must fill a cache line");
+
+// longest line in entries, longer lines are cut
+const int LOG_MAX_LINE_ENTRIES = 32;
+
+class Logger {
+
+  // single-producer single-consumer ring owned by one thread
+  struct Ring {
+    static const uint32_t CAPACITY = 1024;
+    LogEntry entries[CAPACITY];
+    simtime_t stamps[CAPACITY];
+    // head and tail on separate cache lines
+    std::atomic<uint32_t> head;
+    char pad[64];
+    std::atomic<uint32_t> tail;
+    std::atomic<long> dropped;
+    Ring() : head(0), tail(0), dropped(0) {}
+  };
+
+  // rings are only added, a ring outlives the thread that owned it
+  std::vector<Ring*> rings;
+  std::mutex ringsMtx;
+
+  // drain thread
+  pthread_t thread;
+  std::atomic<bool> running;
+  bool stopping = false;
+  int flushInterval = 50;
+  bool dropVerbose = false;
+  unsigned long flushRequested = 0;
+  unsigned long flushDone = 0;
+  std::mutex mtx;
+  std::condition_variable drainCond;
+  std::condition_variable flushCond;
+
+  public:
+    Logger();
+    ~Logger();
+
+    // starts the drain thread, the interval is in milliseconds
+    void start(int flushInterval, bool dropVerbose);
+
+    // drains what is left and writes directly from then on
+    void stop();
+
+    // returns once everything logged before the call is written out
+    void flush();
+
+    void print(const std::string& line);
+
+    // "Polling Station <station>: <message>"
+    void station(int station, const std::string& message);
+
+    // "Polling Station <station>: Voter <voter> voted for <name> (<count>)"
+    // the name must outlive the logger
+    void vote(int station, long voter, const char* name, long count);
+
+    // verbose lines dropped so far
+    long getDropped();
+
+  private:
+    void push(LogEntry& entry, const char* text, size_t length, LogLevel level);
+    Ring* getRing();
+    static void* drainThread(void* arg);
+    void run();
+    size_t drain(std::string& out);
+    static void format(const LogEntry* entries, int count, std::string& out);
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "binlog.hh"
+#include "voter.hh"
+#include "clock.hh"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+
+ /******************************************************************************
+  renders the binary voter log of a simulation as the voters.log text table
+  voters are listed the way the simulation used to dump them: the voters every
+  station starts with first, then arrivals by request time, ties in the order
+  the arrival generators were scanned, replayed runs start with no voters
+  *****************************************************************************/
+
+// executable name
+const std::string sysname = "logview";
+
+class LogOrderComparator {
+  int stations;
+  int generators;
+  bool seeded;
+
+  public:
+    LogOrderComparator(int stations, int generators, bool seeded)
+      : stations(stations), generators(generators), seeded(seeded) {}
+
+    bool operator() (const VoterRecord& v1, const VoterRecord& v2) {
+      // in a seeded run every station opens with two voters, ids 0 and 1
+      bool seeded1 = seeded && v1.id < 2;
+      bool seeded2 = seeded && v2.id < 2;
+      if (seeded1 != seeded2) {
+        return seeded1;
+      }
+      if (!seeded1 && v1.requestTime != v2.requestTime) {
+        return v1.requestTime < v2.requestTime;
+      }
+      if (!seeded1) {
+        int g1 = generatorOf(v1.stationId);
+        int g2 = generatorOf(v2.stationId);
+        if (g1 != g2) {
+          return g1 < g2;
+        }
+      }
+      if (v1.stationId != v2.stationId) {
+        return v1.stationId < v2.stationId;
+      }
+      return v1.id < v2.id;
+    }
+
+  private:
+    // generator g feeds stations [g*C/G, (g+1)*C/G)
+    int generatorOf(int station) {
+      int g = (int)(((long)station * generators) / stations);
+      while (g > 0 && (long)g * stations / generators > station) {
+        g--;
+      }
+      while (g + 1 < generators && (long)(g + 1) * stations / generators <= station) {
+        g++;
+      }
+      return g;
+    }
+};
+
+std::string formatTime(simtime_t time, int precision) {
+  if (precision == 0) {
+    return std::to_string(time / NSEC_PER_SEC);
+  }
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(precision) << ns_to_seconds(time);
+  return out.str();
+}
+
+void print_usage() {
+  std::cout << "usage: " << sysname << " [-i <voter_log>] [-o <text_log>]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+  std::string input = "voters.bin";
+  std::string output = "voters.log";
+
+  // parse command line arguments
+  int c;
+  while ((c = getopt(argc, argv, "i:o:")) != -1) {
+    switch (c) {
+    case 'i':
+      input = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      print_usage();
+      return 0;
+    }
+  }
+
+  FILE* file = fopen(input.c_str(), "rb");
+  if (file == NULL) {
+    std::cerr << sysname << ": cannot open " << input << std::endl;
+    return 1;
+  }
+
+  VoterLogHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || \
+      memcmp(header.magic, VOTER_LOG_MAGIC, sizeof(header.magic)) != 0 || \
+      header.version != VOTER_LOG_VERSION) {
+    std::cerr << sysname << ": " << input << " is not a voter log" << std::endl;
+    fclose(file);
+    return 1;
+  }
+
+  std::vector<VoterRecord> records;
+  VoterRecord record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    records.push_back(record);
+  }
+  fclose(file);
+
+  std::sort(records.begin(), records.end(), LogOrderComparator(header.stations, std::max(1, (int)header.generators), header.seeded != 0));
+
+  int precision = header.precision;
+  std::ofstream log;
+  log.open(output.c_str());
+  log << std::left << std::setw(25) << "StationID.VoterID";
+  log << std::setw(15) << "Category";
+  log << std::setw(25) << "Request Time";
+  log << std::setw(25) << "Polling Station Time";
+  log << std::setw(25) << "Turnaround Time";
+  log << std::endl;
+  for (int i = 0; i < (int)records.size(); i++) {
+    const VoterRecord& voter = records[i];
+    log << std::left << std::setw(25) << std::to_string(voter.stationId) + "." + std::to_string(voter.id);
+    log << std::setw(15) << getFormattedType((VoterType)voter.type);
+    log << std::setw(25) << formatTime(voter.requestTime, precision);
+    log << std::setw(25) << formatTime(voter.pollingTime, precision);
+    log << std::setw(25) << formatTime(voter.pollingTime - voter.requestTime, precision);
+    log << std::endl;
+  }
+  log.close();
+
+}
@@ -1,17 +1,40 @@
 #define _POSIX_C_SOURCE 200112L
-#include "sleep.hh"
+#include "events.hh"
+#include "voter.hh"
+#include "arena.hh"
+#include "queue.hh"
+#include "binlog.hh"
+#include "logger.hh"
+#include "tally.hh"
+#include "ballot.hh"
+#include "sweep.hh"
+#include "histogram.hh"
+#include "failure.hh"
+#include "dispatch.hh"
+#include "rng.hh"
+#include "pool.hh"
+#include "timer.hh"
+#include "snapshot.hh"
+#include "trace.hh"
+#include "shard.hh"
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cstdio>
 #include <cstring>
+#include <cmath>
 #include <string>
 #include <queue>
-#include <map>
+#include <vector>
+#include <tuple>
+#include <algorithm>
 #include <mutex>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -21,455 +44,1944 @@
 // executable name
 const std::string sysname = "simulation";
 
-// safe print utility
-std::mutex print_mtx;
+// asynchronous print utility
+Logger logger;
 void print(std::string msg) {
-  std::lock_guard<std::mutex> lock(print_mtx);
-  std::cout << msg << std::endl;
+  logger.print(msg);
 }
 
-// candidates
-enum class Candidate { Mary, John, Anna };
+// station states
+enum class StationState { Idle, Busy, Repairing, Closed };
 
-// voter types
-enum class VoterType { Ordinary, Special, Mechanic };
+// peers an idle station looks at for voters to take over, and the queue
+// length a working peer needs before it gives any away
+const int STEAL_SCAN = 64;
+const int STEAL_THRESHOLD = 2;
 
-// struct for each voter
-struct Voter {
+// ticks of virtual time between two progress reports of a sharded run
+const int PROGRESS_TICKS = 60;
+
+class PollingStation {
+
+  // station id
   int id;
-  int stationId;
-  pthread_t thread_id;
-  VoterType type;
-  Candidate vote;
-  bool hasVoted = false;
-  time_t requestTime;
-  time_t pollingTime;
-
-  Voter(int id, VoterType type)
-    : id(id), type(type) {}
-
-  void castVote() {
-    pollingTime = time(NULL);
-    int r = rand() % 100 + 1;
-    if (r <= 40) {
-      vote = Candidate::Mary;
-    } else if (r <= 65) {
-      vote = Candidate::John;
-    } else {
-      vote = Candidate::Anna;
-    }
-    hasVoted = true;
-  }
 
-  std::string getFormattedId() {
-    return std::to_string(stationId) + "." + std::to_string(id);
-  }
+  // station state, read by arrival generators deciding whether to wake it
+  std::atomic<StationState> state;
+  std::mutex mtx;
+  simtime_t start_time;
+  simtime_t deadline;
+
+  // the machine broke down while a voter was in the booth, repair starts
+  // once the booth is free
+  bool broken = false;
+
+  // station queue, the voters live in the simulation's arena
+  VoterArena* arena;
+  PollingQueue stationQueue;
+
+  // dispatcher tracking this station's queue length
+  Dispatcher* dispatcher = NULL;
+  int slot;
+
+  // stations of the same dispatcher by slot, with stealing on an idle
+  // station serves voters waiting at a failed or overloaded peer
+  const std::vector<PollingStation*>* peers = NULL;
+  bool STEALING = false;
+
+  // simulation parameters
+  const FailureModel* failureModel;
+  simtime_t WAIT_TIME;
+  simtime_t CAST_TIME;
+  simtime_t FIX_TIME;
+  simtime_t MIN_LOG_THRESHOLD;
+
+  // station-local random stream, only touched by the station's handlers
+  Rng rng;
+
+  // finished voters are streamed here and their records released
+  VoterLogWriter* voterLog;
+
+  // votes are drawn from the ballot and counted in the station's slot of
+  // the simulation's tally
+  const Ballot* ballot;
+  Tally* tally;
+
+  // latency histograms per voter type, created by the first voter of a type
+  std::atomic<LatencySet*> latency[NUM_VOTER_TYPES];
+
+  // voters served together, up to BATCH_SIZE per event, each still gets a
+  // booth for CAST_TIME of its own, one after the other
+  struct ServedVoter {
+    VoterType type;
+    simtime_t request;
+  };
+  int BATCH_SIZE = 1;
+  std::vector<VoterRef> dequeued;
+  std::vector<ServedVoter> batch;
+  simtime_t batchStart;
+
+  // votes and log records of a batch, handed on once per batch
+  std::vector<long> pendingVotes;
+  std::vector<VoterRecord> records;
+
+  // what a run reports, see Simulation::summarize(), readable at any time
+  std::atomic<long> failures;
+  std::atomic<long> served;
+  std::atomic<long> stolen;
+  bool quiet = false;
+
+  public:
+    PollingStation(int id, simtime_t T, const FailureModel* F, simtime_t N, int Q, unsigned seed, VoterArena* arena, VoterLogWriter* voterLog, const Ballot* ballot, Tally* tally)
+    : id(id),
+      state(StationState::Idle),
+      arena(arena),
+      stationQueue(arena, Q),
+      failureModel(F),
+      WAIT_TIME(T),
+      CAST_TIME(2*T),
+      FIX_TIME(5*T),
+      MIN_LOG_THRESHOLD(N),
+      rng(seed, RngStream::Station, id),
+      voterLog(voterLog),
+      ballot(ballot),
+      tally(tally),
+      failures(0),
+      served(0),
+      stolen(0)
+    {
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        latency[i].store(NULL, std::memory_order_relaxed);
+      }
+      pendingVotes.assign(ballot->size(), 0);
+      setBatchSize(1);
+    }
+
+    ~PollingStation() {
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        delete latency[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    int getQueueLength() {
+      return stationQueue.size();
+    }
+
+    PollingQueue* getQueue() {
+      return &stationQueue;
+    }
+
+    void setDispatcher(Dispatcher* dispatcher, int slot) {
+      this->dispatcher = dispatcher;
+      this->slot = slot;
+    }
+
+    void setPeers(const std::vector<PollingStation*>* peers) {
+      this->peers = peers;
+    }
+
+    // returns NO_VOTER if the queue has no room for the voter
+    VoterRef enqueue(VoterType type, simtime_t now, simtime_t deadline) {
+      VoterRef voter = stationQueue.enqueue(type, id, now, deadline);
+      if (voter != NO_VOTER && dispatcher != NULL) {
+        dispatcher->update(slot);
+      }
+      return voter;
+    }
+
+    // the station loop unrolled into event handlers, a station only ever
+    // handles one event at a time, see lock()
+
+    void open(simtime_t start_time, simtime_t deadline, Scheduler& events) {
+      this->start_time = start_time;
+      this->deadline = deadline;
+      state = StationState::Idle;
+      events.push(start_time, EventType::Wakeup, id);
+      scheduleFailure(start_time, events);
+    }
+
+    // the machine broke down, arrivals go to other stations until it is
+    // repaired, voters in the booth finish first
+    void onFailure(simtime_t now, Scheduler& events) {
+      if (deadline - now <= 0 || state == StationState::Closed) {
+        return;
+      }
+      failures.store(failures.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      printMessage("Machine failed");
+      if (dispatcher != NULL) {
+        dispatcher->setDown(slot, true);
+      }
+      if (STEALING) {
+        callPeers(now, events);
+      }
+      if (state == StationState::Busy) {
+        broken = true;
+        return;
+      }
+      repair(now, events);
+    }
+
+    void onRepair(simtime_t now, Scheduler& events) {
+      printMessage("Machine fixed");
+      if (dispatcher != NULL) {
+        dispatcher->setDown(slot, false);
+      }
+      scheduleFailure(now, events);
+      serveNext(now, events);
+    }
+
+    void onArrival(simtime_t now, Scheduler& events) {
+      if (state == StationState::Idle) {
+        serveNext(now, events);
+      }
+    }
+
+    // the batch is done, its time is split evenly between its voters
+    void onCastComplete(simtime_t now, Scheduler& events) {
+      if (!batch.empty()) {
+        simtime_t service = (now - batchStart) / (simtime_t)batch.size();
+        for (int i = 0; i < (int)batch.size(); i++) {
+          LatencySet* set = getLatencySet(batch[i].type);
+          set->metrics[(int)LatencyMetric::Service].record(service);
+          set->metrics[(int)LatencyMetric::Turnaround].record(batchStart + (i + 1) * service - batch[i].request);
+        }
+        batch.clear();
+      }
+      if (broken) {
+        broken = false;
+        repair(now, events);
+        return;
+      }
+      serveNext(now, events);
+    }
+
+    // a voter joined the queue, wake the station if it is waiting for one
+    void wake(simtime_t now, Scheduler& events) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (state.load() == StationState::Idle) {
+        events.push(now, EventType::Wakeup, id);
+      }
+    }
+
+    // serializes the handlers when stations run on a worker pool
+    std::mutex& lock() {
+      return mtx;
+    }
+
+    // called once the clock reaches the deadline, voters still waiting are
+    // logged without a vote
+    void close() {
+      if (state == StationState::Idle) {
+        printMessage("Station " + std::to_string(id) + " finished");
+      }
+      state = StationState::Closed;
+      int n;
+      while ((n = stationQueue.tryDequeue(dequeued.data(), BATCH_SIZE)) > 0) {
+        records.clear();
+        for (int i = 0; i < n; i++) {
+          logVoter(dequeued[i]);
+        }
+        flushRecords();
+      }
+    }
+
+    // everything a station knows besides its configuration, only between
+    // events of a virtual run
+    void save(SnapshotWriter& out) {
+      out.put((uint8_t)state.load());
+      out.put((uint8_t)broken);
+      out.put(rng.getState());
+      out.put(failures.load(std::memory_order_relaxed));
+      out.put(served.load(std::memory_order_relaxed));
+      out.put(stolen.load(std::memory_order_relaxed));
+      out.put(batchStart);
+      out.put((int32_t)batch.size());
+      for (int i = 0; i < (int)batch.size(); i++) {
+        out.put((uint8_t)batch[i].type);
+        out.put(batch[i].request);
+      }
+      for (int c = 0; c < tally->getCandidates(); c++) {
+        out.put(tally->get(id, (Candidate)c));
+      }
+      for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+        LatencySet* set = getLatency((VoterType)t);
+        out.put((uint8_t)(set != NULL));
+        if (set != NULL) {
+          set->save(out);
+        }
+      }
+      stationQueue.save(out);
+    }
+
+    // into a station that was never opened, its events are restored with
+    // the rest of the snapshot
+    void load(SnapshotReader& in, simtime_t start_time, simtime_t deadline) {
+      this->start_time = start_time;
+      this->deadline = deadline;
+      state = (StationState)in.get<uint8_t>();
+      broken = in.get<uint8_t>() != 0;
+      rng.setState(in.get<uint64_t>());
+      failures.store(in.get<long>(), std::memory_order_relaxed);
+      served.store(in.get<long>(), std::memory_order_relaxed);
+      stolen.store(in.get<long>(), std::memory_order_relaxed);
+      batchStart = in.get<simtime_t>();
+      int32_t size = in.get<int32_t>();
+      for (int i = 0; i < size && in.good(); i++) {
+        ServedVoter voter;
+        voter.type = (VoterType)in.get<uint8_t>();
+        voter.request = in.get<simtime_t>();
+        batch.push_back(voter);
+      }
+      for (int c = 0; c < tally->getCandidates(); c++) {
+        tally->add(id, (Candidate)c, in.get<long>());
+      }
+      for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+        if (in.get<uint8_t>() != 0) {
+          getLatencySet((VoterType)t)->load(in);
+        }
+      }
+      stationQueue.load(in);
+    }
+
+    // what the station reports at the end of a run, handed from the shard
+    // that ran it to the parent, see ShardRunner
+    void saveResults(SnapshotWriter& out) {
+      out.put(failures.load(std::memory_order_relaxed));
+      out.put(served.load(std::memory_order_relaxed));
+      out.put(stolen.load(std::memory_order_relaxed));
+      for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+        LatencySet* set = getLatency((VoterType)t);
+        out.put((uint8_t)(set != NULL));
+        if (set != NULL) {
+          set->save(out);
+        }
+      }
+    }
+
+    void loadResults(SnapshotReader& in) {
+      failures.store(in.get<long>(), std::memory_order_relaxed);
+      served.store(in.get<long>(), std::memory_order_relaxed);
+      stolen.store(in.get<long>(), std::memory_order_relaxed);
+      for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+        if (in.get<uint8_t>() != 0) {
+          getLatencySet((VoterType)t)->load(in);
+        }
+      }
+    }
+
+    // gives up to max waiting voters to another station, highest priority
+    // first, safe to call while the station is running
+    int handOver(VoterRef* voters, int max) {
+      int n = stationQueue.tryDequeue(voters, max);
+      if (n > 0 && dispatcher != NULL) {
+        dispatcher->update(slot);
+      }
+      return n;
+    }
+
+    // safe to read while the station is running
+    long getVotes(Candidate candidate) {
+      return tally->get(id, candidate);
+    }
+
+    // NULL until a voter of the type came to the station, safe to read while
+    // the station is running
+    LatencySet* getLatency(VoterType type) {
+      return latency[(int)type].load(std::memory_order_acquire);
+    }
+
+    long getFailures() {
+      return failures.load(std::memory_order_relaxed);
+    }
+
+    // voters taken from the queue so far
+    long getServed() {
+      return served.load(std::memory_order_relaxed);
+    }
+
+    // voters taken from the queues of peers so far
+    long getStolen() {
+      return stolen.load(std::memory_order_relaxed);
+    }
+
+    StationState getState() {
+      return state.load(std::memory_order_relaxed);
+    }
+
+    // a quiet station prints nothing
+    void setQuiet(bool quiet) {
+      this->quiet = quiet;
+    }
+
+    // most voters taken from the queue at once
+    void setBatchSize(int size) {
+      BATCH_SIZE = std::max(1, size);
+      dequeued.resize(BATCH_SIZE);
+      batch.reserve(BATCH_SIZE);
+      records.reserve(BATCH_SIZE);
+    }
+
+    // an idle station serves voters of failed and overloaded peers
+    void setStealing(bool stealing) {
+      STEALING = stealing;
+    }
+
+    // one of the names accepted by isDisciplineMode(), before the first
+    // voter comes
+    void setDiscipline(const std::string& mode) {
+      stationQueue.setDiscipline(makeDiscipline(mode, WAIT_TIME));
+    }
+
+    int getId() {
+      return id;
+    }
+
+    void printMessage(std::string message) {
+      if (!quiet) {
+        logger.station(id, message);
+      }
+    }
+  
+  private:
+    // takes up to max voters into dequeued
+    int tryDequeue(int max) {
+      int n = stationQueue.tryDequeue(dequeued.data(), max);
+      if (n > 0 && dispatcher != NULL) {
+        dispatcher->update(slot);
+      }
+      return n;
+    }
+
+    void serveNext(simtime_t now, Scheduler& events) {
+      if (deadline - now <= 0) {
+        state = StationState::Closed;
+        return;
+      }
+      // only voters who can still get to a booth before the deadline
+      int max = (int)std::min((simtime_t)BATCH_SIZE, (deadline - now + CAST_TIME - 1) / CAST_TIME);
+      int n = tryDequeue(max);
+      if (n == 0 && STEALING) {
+        n = steal(max);
+      }
+      if (n == 0) {
+        state = StationState::Idle;
+        // a voter may have joined while the station still looked busy
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stationQueue.empty() || (n = tryDequeue(max)) == 0) {
+          return;
+        }
+      }
+      vote(n, now);
+      state = StationState::Busy;
+      events.push(now + n * CAST_TIME, EventType::CastComplete, id);
+    }
+
+    // takes voters from the first failed peer with a queue, else from the
+    // peer with the longest queue if it is long enough, a working peer keeps
+    // half of its voters, peers are looked at in slot order from this one
+    int steal(int max) {
+      if (peers == NULL || dispatcher == NULL) {
+        return 0;
+      }
+      int count = peers->size();
+      int scan = std::min(count - 1, STEAL_SCAN);
+      PollingStation* victim = NULL;
+      int longest = STEAL_THRESHOLD - 1;
+      int give = 0;
+      for (int k = 1; k <= scan; k++) {
+        int peer = (slot + k) % count;
+        int length = (*peers)[peer]->getQueueLength();
+        if (length > 0 && dispatcher->isDown(peer)) {
+          victim = (*peers)[peer];
+          give = length;
+          break;
+        }
+        if (length > longest) {
+          victim = (*peers)[peer];
+          longest = length;
+          give = length / 2;
+        }
+      }
+      if (victim == NULL) {
+        return 0;
+      }
+      int n = victim->handOver(dequeued.data(), std::min(max, give));
+      stolen.store(stolen.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      return n;
+    }
+
+    // wakes an idle peer for every voter stuck in the queue of this failed
+    // station
+    void callPeers(simtime_t now, Scheduler& events) {
+      if (peers == NULL) {
+        return;
+      }
+      int count = peers->size();
+      int scan = std::min(count - 1, STEAL_SCAN);
+      int waiting = stationQueue.size();
+      for (int k = 1; k <= scan && waiting > 0; k++) {
+        PollingStation* peer = (*peers)[(slot + k) % count];
+        if (peer->getState() == StationState::Idle) {
+          peer->wake(now, events);
+          waiting--;
+        }
+      }
+    }
+
+    // the first n dequeued voters vote one after the other from now on
+    void vote(int n, simtime_t now) {
+      batchStart = now;
+      records.clear();
+      for (int i = 0; i < n; i++) {
+        VoterRef voter = dequeued[i];
+        simtime_t start = now + i * CAST_TIME;
+        Candidate choice = ballot->draw(rng);
+        arena->castVote(voter, choice, start);
+        pendingVotes[(int)choice]++;
+        ServedVoter served;
+        served.type = arena->getType(voter);
+        served.request = arena->getRequestTime(voter);
+        batch.push_back(served);
+        getLatencySet(served.type)->metrics[(int)LatencyMetric::Wait].record(start - served.request);
+        if (!quiet && start - start_time >= MIN_LOG_THRESHOLD) {
+          long count = tally->get(id, choice) + pendingVotes[(int)choice];
+          logger.vote(id, arena->getId(voter), ballot->getName(choice), count);
+        }
+        logVoter(voter);
+      }
+
+      // results and the voter log once per batch
+      for (int c = 0; c < (int)pendingVotes.size(); c++) {
+        if (pendingVotes[c] > 0) {
+          tally->add(id, (Candidate)c, pendingVotes[c]);
+          pendingVotes[c] = 0;
+        }
+      }
+      served.store(served.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      flushRecords();
+    }
+
+    // queues the record of a voter for the log and releases the voter
+    void logVoter(VoterRef voter) {
+      VoterRecord record;
+      memset(&record, 0, sizeof(record));
+      record.stationId = arena->getStationId(voter);
+      record.id = arena->getId(voter);
+      record.type = (uint8_t)arena->getType(voter);
+      record.hasVoted = arena->hasVoted(voter);
+      record.vote = record.hasVoted ? (uint16_t)arena->getVote(voter) : 0;
+      record.requestTime = arena->getRequestTime(voter) - start_time;
+      record.pollingTime = arena->getPollingTime(voter) - start_time;
+      records.push_back(record);
+      arena->release(voter);
+    }
+
+    void flushRecords() {
+      if (voterLog != NULL && !records.empty()) {
+        voterLog->append(records.data(), records.size());
+      }
+      records.clear();
+    }
+
+    LatencySet* getLatencySet(VoterType type) {
+      LatencySet* set = latency[(int)type].load(std::memory_order_relaxed);
+      if (set == NULL) {
+        set = new LatencySet();
+        latency[(int)type].store(set, std::memory_order_release);
+      }
+      return set;
+    }
+
+    void repair(simtime_t now, Scheduler& events) {
+      state = StationState::Repairing;
+      events.push(now + FIX_TIME, EventType::Repair, id);
+    }
+
+    // the next failure is drawn from the station's own stream
+    void scheduleFailure(simtime_t now, Scheduler& events) {
+      simtime_t delay = failureModel->next(rng);
+      if (delay >= 0 && deadline - (now + delay) > 0) {
+        events.push(now + delay, EventType::Failure, id);
+      }
+    }
+
+};
+
+// an arrival generator feeds a contiguous slice of the stations, the G
+// generators of a run share one arrival per tick, generator g brings the
+// voters of ticks g, g + G, g + 2G, ..., so -g changes how the work is split
+// and not how many voters come
+class ArrivalGenerator {
+
+  // generator id
+  int id;
+
+  // stations in this slice and the dispatcher over their queues
+  std::vector<PollingStation*> stations;
+  Dispatcher* dispatcher;
+
+  // simulation parameters
+  simtime_t WAIT_TIME;
+  float VOTER_PROBABILITY;
+
+  // time between two arrivals of this generator, G ticks
+  simtime_t INTERVAL;
+
+  // generator-local random stream
+  Rng rng;
+
+  // voters that found a full queue
+  int turnedAway = 0;
+
+  public:
+    ArrivalGenerator(int id, const std::vector<PollingStation*>& stations, simtime_t T, float P, int G, const std::string& mode, unsigned seed)
+      : id(id),
+        stations(stations),
+        WAIT_TIME(T),
+        VOTER_PROBABILITY(P),
+        INTERVAL(G * T),
+        rng(seed, RngStream::Arrival, id)
+    {
+      std::vector<PollingQueue*> queues;
+      for (int i = 0; i < (int)stations.size(); i++) {
+        queues.push_back(stations[i]->getQueue());
+      }
+      dispatcher = makeDispatcher(mode, queues, seed, id);
+      for (int i = 0; i < (int)stations.size(); i++) {
+        stations[i]->setDispatcher(dispatcher, i);
+        stations[i]->setPeers(&this->stations);
+      }
+    }
+
+    ~ArrivalGenerator() {
+      delete dispatcher;
+    }
+
+    static void* thread(void* arg) {
+      std::tuple<ArrivalGenerator*, simtime_t, Scheduler*, TimerWheel*>* data = static_cast<std::tuple<ArrivalGenerator*, simtime_t, Scheduler*, TimerWheel*>*>(arg);
+      std::get<0>(*data)->simulate(std::get<1>(*data), *std::get<2>(*data), *std::get<3>(*data));
+      return NULL;
+    }
+
+    PollingStation* getStationWithShortestQueue() {
+      return stations[dispatcher->select()];
+    }
+
+    // a single voter arrives and joins the shortest queue in the slice
+    PollingStation* arrive(simtime_t now, simtime_t deadline) {
+      float probability = rng.uniform();
+      PollingStation* station = getStationWithShortestQueue();
+      VoterType type;
+      if (probability < VOTER_PROBABILITY) {
+        type = VoterType::Ordinary;
+      } else {
+        type = VoterType::Special;
+      }
+      // add to queue
+      VoterRef voter = station->enqueue(type, now, deadline);
+      if (voter == NO_VOTER) {
+        turnedAway++;
+      }
+      return station;
+    }
+
+    // a voter of a trace joins the station it went to, slot is the index
+    // in the slice or -1 for the shortest queue
+    PollingStation* replay(const TraceArrival& arrival, int slot, simtime_t now, simtime_t deadline) {
+      PollingStation* station = slot >= 0 ? stations[slot] : getStationWithShortestQueue();
+      VoterRef voter = station->enqueue(arrival.type, now, deadline);
+      if (voter == NO_VOTER) {
+        turnedAway++;
+      }
+      return station;
+    }
+
+    // one arrival every interval on the wall clock, from the tick of the
+    // generator on, until the deadline or the clock stops
+    void simulate(simtime_t deadline, Scheduler& wakeups, TimerWheel& clock) {
+      simtime_t tick = monotonic_now() + getFirstArrival();
+      if (id > 0 && !clock.sleepUntil(tick)) {
+        return;
+      }
+      simtime_t now = monotonic_now();
+      while (deadline - now > 0) {
+        // enqueue voters
+        arrive(now, deadline)->wake(now, wakeups);
+        // sleep
+        tick += INTERVAL;
+        if (!clock.sleepUntil(tick)) {
+          break;
+        }
+        now = monotonic_now();
+      }
+    }
+
+    int getTurnedAway() {
+      return turnedAway;
+    }
+
+    // time of the first arrival since the start of the run
+    simtime_t getFirstArrival() {
+      return id * WAIT_TIME;
+    }
+
+    simtime_t getInterval() {
+      return INTERVAL;
+    }
+
+    // the random stream and the dispatcher, after the stations were loaded
+    void save(SnapshotWriter& out) {
+      out.put(rng.getState());
+      out.put((int32_t)turnedAway);
+      dispatcher->save(out);
+    }
+
+    void load(SnapshotReader& in) {
+      rng.setState(in.get<uint64_t>());
+      turnedAway = in.get<int32_t>();
+      dispatcher->load(in);
+    }
+
+    int getId() {
+      return id;
+    }
+
+};
+
+class Simulation : public EventHandler, public TimerTarget {
+  
+  // simulation parameters
+  simtime_t SIMULATION_TIME;
+  int NUM_STATIONS;
+  int NUM_GENERATORS;
+  int NUM_WORKERS;
+  int QUEUE_CAPACITY;
+  simtime_t WAIT_TIME;
+  simtime_t MIN_LOG_THRESHOLD;
+  float FAILURE_RATE;
+  float VOTER_PROBABILITY;
+
+  // when machines break down, -f is the chance of a failure per check
+  // interval of ten ticks
+  std::string FAILURE_MODE = "periodic";
+  FailureModel* failureModel = NULL;
+
+  // simulation time
+  simtime_t start_time;
+  simtime_t deadline;
+
+  // election results, live while the stations run, in the shared region
+  // in a sharded run
+  const Ballot* ballot;
+  Tally localTally;
+  Tally* tally;
+
+  // polling stations
+  std::vector<PollingStation*> stations;
+
+  // arrival generators, each owning a slice of the stations
+  std::string DISPATCH_MODE;
+  unsigned SEED;
+  std::vector<ArrivalGenerator*> generators;
+
+  // every voter of the run, freed with the simulation
+  VoterArena arena;
+
+  // voters are logged as they finish, unless the path is empty
+  std::string LOG_PATH;
+  VoterLogWriter voterLog;
+
+  // voters that found a full queue
+  int turnedAway = 0;
+
+  // batch runs print nothing
+  bool quiet = false;
+
+  // most voters a station takes from its queue at once
+  int BATCH_SIZE = 1;
+
+  // idle stations take over voters of failed and overloaded ones
+  bool STEALING = false;
+
+  // which waiting voter a station serves next
+  std::string DISCIPLINE = "strict";
+
+  // latency percentiles, printed at the end and written to a file while
+  // the simulation runs
+  bool LATENCY_REPORT = false;
+  std::string LATENCY_PATH;
+
+  // live counters, rewritten to a file while the simulation runs
+  std::string STATS_PATH;
+  WorkerPool* workerPool = NULL;
+  simtime_t lastStats;
+  std::vector<long> lastServed;
+  std::vector<simtime_t> lastBusy;
+
+  // both files are rewritten every interval of the run
+  simtime_t EXPORT_INTERVAL = 0;
+  simtime_t nextExport;
+
+  // the wheel every wait of the run is scheduled on
+  TimerWheel* clock = NULL;
+
+  // virtual runs write a snapshot every interval, and may start from one
+  std::string CHECKPOINT_PATH;
+  simtime_t CHECKPOINT_INTERVAL = 0;
+  simtime_t nextCheckpoint;
+  std::string RESUME_PATH;
+  EventQueue* pending = NULL;
+
+  // arrivals replayed from a trace instead of drawn by the generators
+  const TraceReader* trace = NULL;
+  size_t traceOffset = 0;
+  TraceArrival nextArrival;
+  long replayed = 0;
+
+  // a sharded run splits the generators over SHARDS processes, the shard a
+  // process runs or -1 in the parent, which runs none, see ShardRunner
+  ShardRegion* region = NULL;
+  int SHARDS = 1;
+  int SHARD = -1;
+  simtime_t nextProgress;
+
+  public:
+    Simulation(simtime_t T, float P, float F, int C, simtime_t N, int TICKS, int Q, std::string D, unsigned S, int G, int W, std::string L, const Ballot* B)
+      : SIMULATION_TIME(TICKS*T),
+        NUM_STATIONS(C),
+        NUM_GENERATORS(std::max(1, std::min(G, C))),
+        NUM_WORKERS(std::max(1, W)),
+        QUEUE_CAPACITY(Q),
+        WAIT_TIME(T),
+        MIN_LOG_THRESHOLD(N),
+        FAILURE_RATE(F),
+        VOTER_PROBABILITY(P),
+        ballot(B),
+        localTally(C, B->size()),
+        tally(&localTally),
+        DISPATCH_MODE(D),
+        SEED(S),
+        LOG_PATH(L)
+    {
+      // without -q size queues for the arrivals a station can expect, so
+      // large station counts stay cheap
+      if (QUEUE_CAPACITY <= 0) {
+        long expected = (long)TICKS / NUM_STATIONS + 2;
+        QUEUE_CAPACITY = (int)std::min((long)DEFAULT_QUEUE_CAPACITY, std::max(8L, expected));
+      }
+    }
+
+    ~Simulation() {
+      for (int g = 0; g < (int)generators.size(); g++) {
+        delete generators[g];
+      }
+      for (int i = 0; i < (int)stations.size(); i++) {
+        delete stations[i];
+      }
+      delete failureModel;
+    }
+
+    void run(bool virtualTime) {
+
+      // get deadline for simulation, the virtual clock starts at zero
+      start_time = virtualTime ? 0 : monotonic_now();
+      deadline = start_time + SIMULATION_TIME;
+
+      // start streaming the voter log, a shard writes its own, merged by
+      // the parent
+      std::string path = SHARD >= 0 && !LOG_PATH.empty() ? getShardLog(SHARD) : LOG_PATH;
+      VoterLogHeader header;
+      memcpy(header.magic, VOTER_LOG_MAGIC, sizeof(header.magic));
+      header.version = VOTER_LOG_VERSION;
+      header.tick = WAIT_TIME;
+      header.stations = NUM_STATIONS;
+      header.generators = NUM_GENERATORS;
+      header.seeded = trace == NULL;
+      header.precision = tick_precision(WAIT_TIME);
+      if (trace != NULL) {
+        header.precision = std::max((int)header.precision, trace->getPrecision());
+      }
+      memset(header.reserved, 0, sizeof(header.reserved));
+      if (!path.empty() && !voterLog.open(path.c_str(), header)) {
+        print("[Simulation] Cannot open " + path);
+        return;
+      }
+      build(path.empty() ? NULL : &voterLog);
+
+      report("[Simulation] Simulation started!");
+
+      if (virtualTime) {
+        runVirtual();
+      } else {
+        runThreaded();
+      }
+
+      report("[Simulation] Simulation finished!");
+
+      // the remaining voters were logged when the stations closed
+      voterLog.close();
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        if (generators[g] != NULL) {
+          turnedAway += generators[g]->getTurnedAway();
+        }
+      }
+
+      // a shard leaves the results to the parent
+      if (SHARD < 0) {
+        finish();
+      }
+    }
+
+    // creates the stations and the generators, once, a shard only creates
+    // its own and leaves the others NULL, the parent of a sharded run
+    // creates all of them for the results but gives none its first voters
+    void build(VoterLogWriter* log) {
+      if (!stations.empty()) {
+        return;
+      }
+
+      // create polling stations
+      failureModel = makeFailureModel(FAILURE_MODE, FAILURE_RATE, 10 * WAIT_TIME);
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        if (SHARD >= 0 && !owns(i)) {
+          stations.push_back(NULL);
+          continue;
+        }
+        PollingStation* station = new PollingStation(i, WAIT_TIME, failureModel, MIN_LOG_THRESHOLD, QUEUE_CAPACITY, SEED, &arena, log, ballot, tally);
+        station->setQuiet(quiet);
+        station->setBatchSize(BATCH_SIZE);
+        station->setStealing(STEALING);
+        station->setDiscipline(DISCIPLINE);
+        if (RESUME_PATH.empty() && trace == NULL && owns(i)) {
+          station->enqueue(VoterType::Special, start_time, deadline);
+          station->enqueue(VoterType::Ordinary, start_time, deadline);
+        }
+        stations.push_back(station);
+      }
+
+      // split the stations into one contiguous slice per generator
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        if (SHARD >= 0 && !ownsGenerator(g)) {
+          generators.push_back(NULL);
+          continue;
+        }
+        std::vector<PollingStation*> slice(stations.begin() + firstSlot(g), stations.begin() + firstSlot(g + 1));
+        generators.push_back(new ArrivalGenerator(g, slice, WAIT_TIME, VOTER_PROBABILITY, NUM_GENERATORS, DISPATCH_MODE, SEED));
+      }
+    }
+
+    // prints and writes the results of a finished run
+    void finish() {
+      if (!quiet) {
+        printResults();
+      }
+      if (!quiet && LATENCY_REPORT) {
+        std::stringstream report;
+        writeLatency(report, true);
+        std::string line;
+        while (std::getline(report, line)) {
+          print(line);
+        }
+      }
+      if (!LATENCY_PATH.empty()) {
+        exportLatency(deadline);
+      }
+      if (!STATS_PATH.empty()) {
+        exportStats(deadline);
+      }
+
+    }
+
+    // the region the shards share, its tally replaces the simulation's
+    void setShards(ShardRegion* region) {
+      this->region = region;
+      SHARDS = region->size();
+      tally = region->getTally();
+    }
+
+    // the shard this process runs, called in the forked process
+    void setShard(int shard) {
+      SHARD = shard;
+    }
+
+    std::string getShardLog(int shard) {
+      return LOG_PATH + ".shard" + std::to_string(shard);
+    }
+
+    // the results of a shard, written by the shard once it finished
+    void saveResults(SnapshotWriter& out) {
+      for (int i = firstStation(SHARD); i < firstStation(SHARD + 1); i++) {
+        stations[i]->saveResults(out);
+      }
+      out.put((long)turnedAway);
+    }
+
+    // and read by the parent, false if the shard did not finish writing
+    bool loadResults(SnapshotReader& in, int shard) {
+      start_time = 0;
+      deadline = SIMULATION_TIME;
+      build(NULL);
+      if (lastServed.empty()) {
+        startExports(start_time);
+      }
+      for (int i = firstStation(shard); i < firstStation(shard + 1); i++) {
+        stations[i]->loadResults(in);
+      }
+      long shardTurnedAway = in.get<long>();
+      if (!in.good()) {
+        return false;
+      }
+      turnedAway += shardTurnedAway;
+      return true;
+    }
+
+    void setQuiet(bool quiet) {
+      this->quiet = quiet;
+    }
+
+    void setBatchSize(int size) {
+      BATCH_SIZE = size;
+    }
+
+    // one of the names accepted by isFailureMode()
+    void setFailureModel(std::string mode) {
+      FAILURE_MODE = mode;
+    }
+
+    void setStealing(bool stealing) {
+      STEALING = stealing;
+    }
+
+    // one of the names accepted by isDisciplineMode()
+    void setDiscipline(std::string mode) {
+      DISCIPLINE = mode;
+    }
+
+    // writes a snapshot of a virtual run to path every interval
+    void setCheckpoint(std::string path, simtime_t interval) {
+      CHECKPOINT_PATH = path;
+      CHECKPOINT_INTERVAL = interval;
+    }
+
+    // a virtual run starts from the snapshot at path instead of the opening
+    // of the polling stations
+    void setResume(std::string path) {
+      RESUME_PATH = path;
+    }
+
+    // arrivals come from the trace, which outlives the simulation
+    void setTrace(const TraceReader* trace) {
+      this->trace = trace;
+    }
+
+    // prints the latency percentiles at the end of the run
+    void setLatencyReport(bool report) {
+      LATENCY_REPORT = report;
+    }
+
+    // rewrites the latency percentiles to path every export interval
+    void setLatencyExport(std::string path) {
+      LATENCY_PATH = path;
+    }
+
+    // rewrites the live counters to path every export interval
+    void setStatsExport(std::string path) {
+      STATS_PATH = path;
+    }
+
+    void setExportInterval(simtime_t interval) {
+      EXPORT_INTERVAL = interval;
+    }
+
+    // throughput, turnaround and failures of a finished run
+    void summarize(RunSummary& summary) {
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        summary.failures += stations[i]->getFailures();
+        summary.stolen += stations[i]->getStolen();
+      }
+      summary.votes = getTotalVotes();
+      summary.turnedAway = turnedAway;
+      summary.throughput = summary.votes / ns_to_seconds(SIMULATION_TIME);
+      LatencyHistogram turnaround;
+      mergeLatency(turnaround, LatencyMetric::Turnaround, -1, -1);
+      summary.meanTurnaround = ns_to_seconds(turnaround.mean());
+      summary.p95Turnaround = ns_to_seconds(turnaround.percentile(0.95));
+      summary.p99Turnaround = ns_to_seconds(turnaround.percentile(0.99));
+      for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+        LatencyHistogram type;
+        mergeLatency(type, LatencyMetric::Turnaround, t, -1);
+        summary.p99TurnaroundByType[t] = ns_to_seconds(type.percentile(0.99));
+      }
+    }
+
+    // stations run as tasks on a worker pool, advancing on the wall clock
+    void runThreaded() {
+
+      // one timer thread serves the workers, the generators and the exports,
+      // a wheel tick is a hundredth of a simulation tick within 10us to 1ms
+      TimerWheel wheel(std::max(10000LL, std::min(1000000LL, (long long)WAIT_TIME / 100)), start_time);
+      clock = &wheel;
+      wheel.start();
+
+      // workers
+      WorkerPool pool(NUM_WORKERS, this, deadline, &wheel);
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        stations[i]->open(start_time, deadline, pool);
+      }
+      pool.start();
+
+      // create arrival generator threads
+      std::vector<pthread_t> generatorThreads(NUM_GENERATORS);
+      std::vector<std::tuple<ArrivalGenerator*, simtime_t, Scheduler*, TimerWheel*>> generatorThreadData;
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        generatorThreadData.push_back(std::make_tuple(generators[g], deadline, (Scheduler*)&pool, &wheel));
+      }
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        pthread_create(&generatorThreads[g], NULL, &ArrivalGenerator::thread, &generatorThreadData[g]);
+      }
+
+      // export the latencies and counters while the generators run
+      workerPool = &pool;
+      startExports(start_time);
+      while (exporting() && deadline - nextExport > 0) {
+        wheel.sleepUntil(nextExport);
+        exportLive(nextExport);
+      }
+
+      // wait for threads to finish
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        pthread_join(generatorThreads[g], NULL);
+      }
+      report("[Simulation] No more voters are coming!");
+      wheel.sleepUntil(deadline);
+      pool.stop();
+      wheel.stop();
+      clock = NULL;
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        stations[i]->close();
+      }
+
+      printUtilization(pool);
+      workerPool = NULL;
+    }
+
+    // discrete-event loop on a virtual clock, runs as fast as the cpu allows
+    // the export and checkpoint timers sit on a wheel advanced to the time
+    // of every event before it is taken from the queue
+    void runVirtual() {
+      EventQueue events;
+      TimerWheel wheel(1, start_time);
+      clock = &wheel;
+      pending = &events;
+
+      simtime_t now = start_time;
+      if (!RESUME_PATH.empty()) {
+        std::string error;
+        if (!loadSnapshot(events, now, error)) {
+          report("[Simulation] " + error);
+          events = EventQueue();
+        } else {
+          report("[Simulation] Resumed at " + formatSeconds(now - start_time) + " seconds");
+        }
+      } else {
+        // stations enter their loop first, then the first voters arrive
+        for (int i = 0; i < NUM_STATIONS; i++) {
+          if (owns(i)) {
+            stations[i]->open(start_time, deadline, events);
+          }
+        }
+        if (trace != NULL) {
+          report("[Simulation] Replaying " + std::to_string(trace->size()) + " arrivals");
+          traceOffset = 0;
+          if (trace->next(traceOffset, nextArrival)) {
+            events.push(start_time + nextArrival.time, EventType::Replay, 0);
+          }
+        } else {
+          for (int g = 0; g < NUM_GENERATORS; g++) {
+            if (ownsGenerator(g)) {
+              events.push(start_time + generators[g]->getFirstArrival(), EventType::Arrival, g);
+            }
+          }
+        }
+      }
+
+      // a shard exports nothing, the parent starts the exports of a sharded
+      // run once it has the results of the shards
+      if (SHARD < 0) {
+        startExports(now);
+      }
+      if (exporting()) {
+        scheduleExport();
+      }
+      if (!CHECKPOINT_PATH.empty() && CHECKPOINT_INTERVAL > 0) {
+        nextCheckpoint = start_time + CHECKPOINT_INTERVAL;
+        while (now - nextCheckpoint >= 0) {
+          nextCheckpoint += CHECKPOINT_INTERVAL;
+        }
+        scheduleCheckpoint();
+      }
+      if (SHARD >= 0 && !quiet) {
+        nextProgress = start_time + PROGRESS_TICKS * WAIT_TIME;
+        scheduleProgress();
+      }
+      while (!events.empty() && deadline - events.top().time > 0) {
+        wheel.advance(events.top().time);
+        Event event = events.pop();
+        handle(event, event.time, events);
+      }
+      clock = NULL;
+      pending = NULL;
 
-  std::string getFormattedType() {
-    if (type == VoterType::Ordinary) {
-      return "O";
-    } else if (type == VoterType::Special) {
-      return "S";
-    } else {
-      return "M";
+      report("[Simulation] No more voters are coming!");
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        if (owns(i)) {
+          stations[i]->close();
+        }
+      }
     }
-  }
-  
-
-};
 
-class VoterComparator {
-  public:
-    bool operator() (Voter* v1, Voter* v2) {
-        return v1->type < v2->type;
+    void handle(const Event& event, simtime_t now, Scheduler& scheduler) {
+      if (event.type == EventType::Arrival) {
+        PollingStation* station = generators[event.target]->arrive(now, deadline);
+        station->onArrival(now, scheduler);
+        scheduler.push(now + generators[event.target]->getInterval(), EventType::Arrival, event.target);
+        return;
+      }
+      if (event.type == EventType::Replay) {
+        replay(now, scheduler);
+        return;
+      }
+      PollingStation* station = stations[event.target];
+      std::lock_guard<std::mutex> lock(station->lock());
+      switch (event.type) {
+      case EventType::CastComplete:
+        station->onCastComplete(now, scheduler);
+        break;
+      case EventType::Failure:
+        station->onFailure(now, scheduler);
+        break;
+      case EventType::Repair:
+        station->onRepair(now, scheduler);
+        break;
+      case EventType::Wakeup:
+        station->onArrival(now, scheduler);
+        break;
+      default:
+        break;
+      }
     }
-};
 
-class PollingQueue {
-  std::priority_queue<Voter*, std::vector<Voter*>, VoterComparator> voters;
-  std::mutex mtx;
-  std::condition_variable cond;
-  int counter = 0;
-  time_t deadline;
+    // every arrival of the trace due now, then one event for the next
+    // arrival, so only one line of the trace is ever in the event queue
+    // voters the trace puts at a station that does not exist are sent to
+    // the shortest queue, voters without a station go to the generators in
+    // turn, a shard skips the voters of generators it does not run
+    void replay(simtime_t now, Scheduler& scheduler) {
+      bool more;
+      do {
+        int g = replayed % NUM_GENERATORS;
+        int slot = -1;
+        for (int i = 0; i < NUM_GENERATORS && nextArrival.station >= 0 && slot < 0; i++) {
+          if (nextArrival.station >= firstSlot(i) && nextArrival.station < firstSlot(i + 1)) {
+            slot = nextArrival.station - firstSlot(i);
+            g = i;
+          }
+        }
+        if (ownsGenerator(g)) {
+          generators[g]->replay(nextArrival, slot, now, deadline)->onArrival(now, scheduler);
+        }
+        replayed++;
+        more = trace->next(traceOffset, nextArrival);
+      } while (more && start_time + nextArrival.time - now <= 0);
+      if (more) {
+        scheduler.push(start_time + nextArrival.time, EventType::Replay, 0);
+      }
+    }
 
-  public:
-    PollingQueue() {
-    
+    void printUtilization(WorkerPool& pool) {
+      simtime_t elapsed = pool.getElapsed();
+      for (int i = 0; i < pool.size(); i++) {
+        const WorkerStats& stats = pool.getStats(i);
+        std::ostringstream line;
+        line << "[Pool] Worker " << i << ": ";
+        line << std::fixed << std::setprecision(2);
+        line << (elapsed > 0 ? 100.0 * stats.busy.load() / elapsed : 0) << "% busy, ";
+        line << stats.tasks.load() << " tasks, " << stats.steals.load() << " stolen";
+        print(line.str());
+      }
     }
 
-    Voter* enqueue(VoterType type) {
-      std::lock_guard<std::mutex> lock(mtx);
-      Voter* voter = new Voter(counter++, type);
-      voters.push(voter);
-      cond.notify_one();
-      return voter;
+    long getTotalVotes() {
+      return tally->total();
     }
 
-    Voter* dequeue() {
-      std::unique_lock<std::mutex> lock(mtx);
-      while(voters.empty() && difftime(deadline, time(NULL)) >= 0) {
-        cond.wait_until(
-          lock,
-          std::chrono::system_clock::from_time_t(deadline)
-        );
+    // in a sharded run the first shard speaks for all of them
+    void report(std::string message) {
+      if (!quiet && SHARD <= 0) {
+        print(message);
       }
-      if (voters.empty() && difftime(deadline, time(NULL)) < 0) {
-        return NULL;
-      }
-      Voter* voter = voters.top();
-      voters.pop();
-      return voter;
     }
 
-    void setDeadline(time_t deadline) {
-      std::lock_guard<std::mutex> lock(mtx);
-      this->deadline = deadline;
-      cond.notify_all();
+    // merges the histograms of a metric for one voter type at one station,
+    // a negative type or station stands for all of them
+    void mergeLatency(LatencyHistogram& into, LatencyMetric metric, int type, int station) {
+      int firstStation = station < 0 ? 0 : station;
+      int lastStation = station < 0 ? NUM_STATIONS - 1 : station;
+      int firstType = type < 0 ? 0 : type;
+      int lastType = type < 0 ? NUM_VOTER_TYPES - 1 : type;
+      for (int i = firstStation; i <= lastStation; i++) {
+        for (int t = firstType; t <= lastType; t++) {
+          LatencySet* set = stations[i]->getLatency((VoterType)t);
+          if (set != NULL) {
+            into.merge(set->metrics[(int)metric]);
+          }
+        }
+      }
     }
 
-    bool empty() {
-      std::unique_lock<std::mutex> lock(mtx);
-      return voters.empty();
+    // one row of percentiles in seconds per metric, by voter type, then by
+    // station if asked to
+    void writeLatency(std::ostream& out, bool perStation) {
+      const double PERCENTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+      out << std::left << std::setw(14) << "Scope" << std::setw(12) << "Metric";
+      out << std::right << std::setw(10) << "Count" << std::setw(12) << "Mean";
+      out << std::setw(12) << "p50" << std::setw(12) << "p90" << std::setw(12) << "p99";
+      out << std::setw(12) << "p99.9" << std::setw(12) << "Max" << std::endl;
+      int scopes = NUM_VOTER_TYPES + 1 + (perStation ? NUM_STATIONS : 0);
+      for (int scope = 0; scope < scopes; scope++) {
+        int type = scope < NUM_VOTER_TYPES ? scope : -1;
+        int station = scope > NUM_VOTER_TYPES ? scope - NUM_VOTER_TYPES - 1 : -1;
+        std::string name = type >= 0 ? "type " + getFormattedType((VoterType)type) : (station >= 0 ? "station " + std::to_string(station) : "all");
+        for (int m = 0; m < NUM_LATENCY_METRICS; m++) {
+          LatencyHistogram histogram;
+          mergeLatency(histogram, (LatencyMetric)m, type, station);
+          if (histogram.count() == 0) {
+            continue;
+          }
+          out << std::left << std::setw(14) << name << std::setw(12) << getLatencyMetricName((LatencyMetric)m);
+          out << std::right << std::setw(10) << histogram.count();
+          out << std::fixed << std::setprecision(4);
+          out << std::setw(12) << ns_to_seconds(histogram.mean());
+          for (int p = 0; p < 4; p++) {
+            out << std::setw(12) << ns_to_seconds(histogram.percentile(PERCENTILES[p]));
+          }
+          out << std::setw(12) << ns_to_seconds(histogram.getMax()) << std::endl;
+        }
+      }
     }
 
-    int size() {
-      std::unique_lock<std::mutex> lock(mtx);
-      return voters.size();
+    // replaces the export file, readers never see a partly written one
+    void exportLatency(simtime_t now) {
+      std::string temporary = LATENCY_PATH + ".tmp";
+      std::ofstream out(temporary.c_str());
+      out << "# latencies after " << std::fixed << std::setprecision(3) << ns_to_seconds(now - start_time) << " seconds" << std::endl;
+      writeLatency(out, true);
+      out.close();
+      rename(temporary.c_str(), LATENCY_PATH.c_str());
     }
-};
-
-class PollingStation {
 
-  // station id
-  int id;
+    // live counters in the Prometheus text format, only atomics are read so
+    // the stations keep running undisturbed, rates are over the time since
+    // the previous export
+    void exportStats(simtime_t now) {
+      double interval = ns_to_seconds(now - lastStats);
+      std::string temporary = STATS_PATH + ".tmp";
+      std::ofstream out(temporary.c_str());
+      out << std::fixed << std::setprecision(3);
+      out << "# election simulation after " << ns_to_seconds(now - start_time) << " seconds" << std::endl;
+      out << "sim_elapsed_seconds " << ns_to_seconds(now - start_time) << std::endl;
+      out << "sim_votes_total " << tally->total() << std::endl;
+      for (int c = 0; c < ballot->size(); c++) {
+        out << "sim_candidate_votes{candidate=\"" << ballot->getName((Candidate)c) << "\"} " << tally->total((Candidate)c) << std::endl;
+      }
+      long repairing = 0;
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        repairing += stations[i]->getState() == StationState::Repairing;
+      }
+      out << "sim_stations_repairing " << repairing << std::endl;
 
-  // station queue
-  PollingQueue stationQueue;
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        PollingStation* station = stations[i];
+        long served = station->getServed();
+        std::string label = "{station=\"" + std::to_string(i) + "\"}";
+        out << "station_queue_depth" << label << " " << station->getQueueLength() << std::endl;
+        out << "station_dequeue_rate" << label << " " << (interval > 0 ? (served - lastServed[i]) / interval : 0) << std::endl;
+        out << "station_failures_total" << label << " " << station->getFailures() << std::endl;
+        out << "station_repairing" << label << " " << (station->getState() == StationState::Repairing) << std::endl;
+        for (int c = 0; c < ballot->size(); c++) {
+          out << "station_votes{station=\"" << i << "\",candidate=\"" << ballot->getName((Candidate)c) << "\"} " << station->getVotes((Candidate)c) << std::endl;
+        }
+        lastServed[i] = served;
+      }
 
-  // simulation parameters
-  float FAILURE_RATE;
-  int WAIT_TIME;
-  int CAST_TIME;
-  int FAILURE_CHECK_FREQUENCY;
-  int FIX_TIME;
-  int MIN_LOG_THRESHOLD;
+      // wall clock utilization of the worker threads, threaded runs only
+      for (int w = 0; workerPool != NULL && w < workerPool->size(); w++) {
+        const WorkerStats& stats = workerPool->getStats(w);
+        simtime_t busy = stats.busy.load(std::memory_order_relaxed);
+        std::string label = "{worker=\"" + std::to_string(w) + "\"}";
+        out << "worker_utilization" << label << " " << (interval > 0 ? ns_to_seconds(busy - lastBusy[w]) / interval : 0) << std::endl;
+        out << "worker_tasks_total" << label << " " << stats.tasks.load(std::memory_order_relaxed) << std::endl;
+        out << "worker_steals_total" << label << " " << stats.steals.load(std::memory_order_relaxed) << std::endl;
+        lastBusy[w] = busy;
+      }
+      out.close();
+      rename(temporary.c_str(), STATS_PATH.c_str());
+      lastStats = now;
+    }
 
-  // local results
-  std::map<Candidate, std::string> candidates;
-  std::map<Candidate, int> results;
+    // the first export is the first interval after from
+    void startExports(simtime_t from) {
+      nextExport = start_time + EXPORT_INTERVAL;
+      while (EXPORT_INTERVAL > 0 && from - nextExport >= 0) {
+        nextExport += EXPORT_INTERVAL;
+      }
+      lastStats = from;
+      lastServed.assign(NUM_STATIONS, 0);
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        lastServed[i] = stations[i]->getServed();
+      }
+      lastBusy.assign(workerPool != NULL ? workerPool->size() : 0, 0);
+    }
 
-  public:
-    PollingStation(int id, int T, float F, int N) 
-    : id(id),
-      FAILURE_RATE(F),
-      WAIT_TIME(T),
-      CAST_TIME(2*T),
-      FAILURE_CHECK_FREQUENCY(10*T),
-      FIX_TIME(5*T),
-      MIN_LOG_THRESHOLD(N)
-    {
-      // map candidates to results
-      results.insert(std::pair<Candidate, int>(Candidate::Mary, 0));
-      results.insert(std::pair<Candidate, int>(Candidate::John, 0));
-      results.insert(std::pair<Candidate, int>(Candidate::Anna, 0));
+    // writes the export files due at time now
+    void exportLive(simtime_t now) {
+      if (!LATENCY_PATH.empty()) {
+        exportLatency(now);
+      }
+      if (!STATS_PATH.empty()) {
+        exportStats(now);
+      }
+      nextExport += EXPORT_INTERVAL;
+    }
 
-      // map candidates to names
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::Mary, "Mary"));
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::John, "John"));
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::Anna, "Anna"));
+    // the next live export of a virtual run
+    void scheduleExport() {
+      Event event = Event();
+      event.time = nextExport;
+      event.type = EventType::Export;
+      clock->schedule(nextExport, this, event);
     }
 
-    int getQueueLength() {
-      return stationQueue.size();
+    void scheduleCheckpoint() {
+      Event event = Event();
+      event.time = nextCheckpoint;
+      event.type = EventType::Checkpoint;
+      clock->schedule(nextCheckpoint, this, event);
     }
 
-    Voter* enqueue(VoterType type, time_t deadline) {
-      Voter* voter = stationQueue.enqueue(type);
-      voter->stationId = id;
-      voter->requestTime = time(NULL);
-      voter->pollingTime = deadline;
-      return voter;
+    void scheduleProgress() {
+      Event event = Event();
+      event.time = nextProgress;
+      event.type = EventType::Progress;
+      clock->schedule(nextProgress, this, event);
     }
 
-    void simulate(time_t start_time, time_t deadline) {
+    void expire(const Event& event) {
+      if (event.type == EventType::Progress) {
+        progress(event.time);
+        nextProgress += PROGRESS_TICKS * WAIT_TIME;
+        scheduleProgress();
+        return;
+      }
+      if (event.type == EventType::Checkpoint) {
+        checkpoint(event.time);
+        nextCheckpoint += CHECKPOINT_INTERVAL;
+        scheduleCheckpoint();
+        return;
+      }
+      exportLive(event.time);
+      scheduleExport();
+    }
 
-      // set deadline for queue
-      stationQueue.setDeadline(deadline);
+    // publishes the votes and the longest queue of the shard, waits for the
+    // other shards to get as far and has the first shard report on all of
+    // them
+    void progress(simtime_t now) {
+      long votes = 0;
+      int longest = firstStation(SHARD);
+      for (int i = firstStation(SHARD); i < firstStation(SHARD + 1); i++) {
+        for (int c = 0; c < ballot->size(); c++) {
+          votes += tally->get(i, (Candidate)c);
+        }
+        longest = stations[i]->getQueueLength() > stations[longest]->getQueueLength() ? i : longest;
+      }
+      int round = (int)((now - start_time) / (PROGRESS_TICKS * WAIT_TIME));
+      region->publish(SHARD, round, now, votes, stations[longest]->getQueueLength(), longest);
+      region->awaitProgress(now);
+      if (SHARD != 0) {
+        return;
+      }
+      votes = 0;
+      int shard = 0;
+      for (int s = 0; s < SHARDS; s++) {
+        votes += region->getVotes(s, round);
+        shard = region->getLongest(s, round) > region->getLongest(shard, round) ? s : shard;
+      }
+      report("[Shards] " + formatSeconds(now - start_time) + " seconds: " + std::to_string(votes) + " votes, longest queue " +
+        std::to_string(region->getLongest(shard, round)) + " at station " + std::to_string(region->getLongestStation(shard, round)));
+    }
 
-      // initialize failure checkpoint
-      time_t lastFailureCheck = time(NULL);
+    // the first station of the slice of a generator
+    int firstSlot(int g) {
+      return (int)((long)g * NUM_STATIONS / NUM_GENERATORS);
+    }
 
-      // simulate
-      while (difftime(deadline, time(NULL)) > 0) {
+    // the generators of a shard and the stations of their slices
+    int firstGenerator(int shard) {
+      return (int)((long)shard * NUM_GENERATORS / SHARDS);
+    }
 
-        // check for failure
-        if (difftime(time(NULL), lastFailureCheck) >= FAILURE_CHECK_FREQUENCY) {
-          lastFailureCheck = time(NULL);
-          if (machineFailed()) {
-            printMessage("Machine failed");
-            pthread_sleep(FIX_TIME);
-            printMessage("Machine fixed");
-          }
-        }
+    int firstStation(int shard) {
+      return firstSlot(firstGenerator(shard));
+    }
 
-        // dequeue voter and cast vote
-        Voter* voter = dequeue();
-        if (voter == NULL) {
-          printMessage("Station " + std::to_string(id) + " finished");
-          break;
-        }
-        voter->castVote();
-        results[voter->vote]++;
-        if (difftime(time(NULL), start_time) >= MIN_LOG_THRESHOLD) {
-          printMessage(
-            "Voter " + \
-            std::to_string(voter->id) + \
-            " voted for " + \
-            candidates[voter->vote] + \
-            " (" + \
-            std::to_string(results[voter->vote]) + \
-            ")"
-          );
-        }
+    // whether this process runs the generator or the station, everything
+    // unless the run is sharded, nothing in the parent of a sharded run
+    bool ownsGenerator(int g) {
+      if (SHARD < 0) {
+        return SHARDS <= 1;
+      }
+      return g >= firstGenerator(SHARD) && g < firstGenerator(SHARD + 1);
+    }
 
-        pthread_sleep(CAST_TIME);
+    bool owns(int station) {
+      if (SHARD < 0) {
+        return SHARDS <= 1;
       }
+      return station >= firstStation(SHARD) && station < firstStation(SHARD + 1);
     }
 
-    std::map<Candidate, int> getResults() {
-      return results;
+    // replaces the snapshot file, a crash while writing leaves the previous
+    // snapshot in place
+    void checkpoint(simtime_t now) {
+      std::string temporary = CHECKPOINT_PATH + ".tmp";
+      SnapshotWriter out;
+      if (!out.open(temporary.c_str())) {
+        report("[Simulation] Cannot open " + temporary);
+        return;
+      }
+      SnapshotHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+      header.version = SNAPSHOT_VERSION;
+      header.clock = now - start_time;
+      header.tick = WAIT_TIME;
+      header.stations = NUM_STATIONS;
+      header.generators = NUM_GENERATORS;
+      header.queueCapacity = QUEUE_CAPACITY;
+      header.candidates = ballot->size();
+      strncpy(header.dispatchMode, DISPATCH_MODE.c_str(), sizeof(header.dispatchMode) - 1);
+      header.simulationTime = SIMULATION_TIME;
+      header.probability = VOTER_PROBABILITY;
+      header.failureRate = FAILURE_RATE;
+      strncpy(header.failureMode, FAILURE_MODE.c_str(), sizeof(header.failureMode) - 1);
+      header.batchSize = BATCH_SIZE;
+      header.seed = SEED;
+      header.stealing = STEALING;
+      strncpy(header.discipline, DISCIPLINE.c_str(), sizeof(header.discipline) - 1);
+      struct stat log;
+      if (!LOG_PATH.empty() && stat(LOG_PATH.c_str(), &log) == 0) {
+        header.logDevice = log.st_dev;
+        header.logInode = log.st_ino;
+      }
+      out.put(header);
+      pending->save(out);
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        stations[i]->save(out);
+      }
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        generators[g]->save(out);
+      }
+      if (!out.close()) {
+        report("[Simulation] Cannot write " + temporary);
+        return;
+      }
+      rename(temporary.c_str(), CHECKPOINT_PATH.c_str());
+      report("[Simulation] Checkpoint at " + formatSeconds(now - start_time) + " seconds");
     }
 
-    int getId() {
-      return id;
+    // restores the events, stations and generators, now is set to the time
+    // of the snapshot, the structure of the run has to match
+    bool loadSnapshot(EventQueue& events, simtime_t& now, std::string& error) {
+      SnapshotHeader header;
+      if (!readSnapshotHeader(RESUME_PATH, header, error)) {
+        return false;
+      }
+      if (header.tick != WAIT_TIME || header.stations != NUM_STATIONS || header.generators != NUM_GENERATORS ||
+          header.queueCapacity != QUEUE_CAPACITY || header.candidates != ballot->size() ||
+          DISPATCH_MODE != std::string(header.dispatchMode, strnlen(header.dispatchMode, sizeof(header.dispatchMode)))) {
+        error = RESUME_PATH + " was taken with other -t, -c, -g, -q, -d or ballot";
+        return false;
+      }
+      SnapshotReader in;
+      in.open(RESUME_PATH.c_str());
+      in.get<SnapshotHeader>();
+      now = start_time + header.clock;
+      events.load(in);
+      for (int i = 0; i < NUM_STATIONS; i++) {
+        stations[i]->load(in, start_time, deadline);
+      }
+      for (int g = 0; g < NUM_GENERATORS; g++) {
+        generators[g]->load(in);
+      }
+      if (!in.good()) {
+        error = RESUME_PATH + " is truncated";
+        return false;
+      }
+      return true;
     }
 
-    void printMessage(std::string message) {
-      std::lock_guard<std::mutex> lock(print_mtx);
-      std::cout << "Polling Station " << id << ": " << message << std::endl;
+    std::string formatSeconds(simtime_t time) {
+      std::ostringstream text;
+      text << std::fixed << std::setprecision(tick_precision(WAIT_TIME)) << ns_to_seconds(time);
+      return text.str();
     }
-  
-  private:
-    Voter* dequeue() {
-      return stationQueue.dequeue();
+
+    // shards only see their own stations, the parent writes the files once
+    // they finished
+    bool exporting() {
+      return (!LATENCY_PATH.empty() || !STATS_PATH.empty()) && EXPORT_INTERVAL > 0 && SHARD < 0;
     }
 
-    bool machineFailed() {
-      return (double)rand() / RAND_MAX < FAILURE_RATE;
+    void printResults() {
+      print("Total votes: " + std::to_string(getTotalVotes()));
+      if (turnedAway > 0) {
+        print("Turned away: " + std::to_string(turnedAway));
+      }
+      if (STEALING) {
+        long stolen = 0;
+        for (int i = 0; i < NUM_STATIONS; i++) {
+          stolen += stations[i]->getStolen();
+        }
+        print("Stolen: " + std::to_string(stolen));
+      }
+      for (int c = 0; c < ballot->size(); c++) {
+        print(std::string(ballot->getName((Candidate)c)) + ": " + std::to_string(tally->total((Candidate)c)));
+      }
     }
 
 };
 
-class Simulation {
-  
-  // simulation parameters
-  int SIMULATION_TIME;
-  int NUM_STATIONS;
-  int WAIT_TIME;
-  int MIN_LOG_THRESHOLD;
-  float FAILURE_RATE;
-  float VOTER_PROBABILITY;
+// runs the configurations of a sweep in virtual time, one simulation per
+// thread at a time, the other parameters are shared by every run
+class BatchRunner {
+
+  const std::vector<SweepConfig>& configs;
+  std::vector<RunSummary> summaries;
+  std::atomic<int> next;
+
+  // shared parameters
+  simtime_t MIN_LOG_THRESHOLD;
+  int QUEUE_CAPACITY;
+  std::string DISPATCH_MODE;
+  int NUM_GENERATORS;
+  const Ballot* ballot;
+  int BATCH_SIZE = 1;
+  std::string FAILURE_MODE = "periodic";
+  bool STEALING = false;
+  std::string DISCIPLINE = "strict";
+  const TraceReader* trace = NULL;
 
-  // simulation time
-  time_t start_time;
-  time_t deadline;
+  public:
+    BatchRunner(const std::vector<SweepConfig>& configs, simtime_t N, int Q, std::string D, int G, const Ballot* B)
+      : configs(configs),
+        summaries(configs.size()),
+        next(0),
+        MIN_LOG_THRESHOLD(N),
+        QUEUE_CAPACITY(Q),
+        DISPATCH_MODE(D),
+        NUM_GENERATORS(G),
+        ballot(B) {}
+
+    void run(int threads) {
+      threads = std::max(1, std::min(threads, (int)configs.size()));
+      std::vector<pthread_t> workers(threads);
+      for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, &BatchRunner::thread, this);
+      }
+      for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+      }
+    }
 
-  // election results
-  std::map<Candidate, std::string> candidates;
-  std::map<Candidate, int> results;
+    void setBatchSize(int size) {
+      BATCH_SIZE = size;
+    }
 
-  // polling stations
-  std::vector<PollingStation*> stations;
+    void setFailureModel(std::string mode) {
+      FAILURE_MODE = mode;
+    }
 
-  // polling history
-  std::vector<Voter*> history;
+    void setStealing(bool stealing) {
+      STEALING = stealing;
+    }
 
-  public:
-    Simulation(int T, float P, float F, int C, int N, int TICKS)
-      : SIMULATION_TIME(TICKS*T),
-        NUM_STATIONS(C),
-        WAIT_TIME(T),
-        FAILURE_RATE(F),
-        VOTER_PROBABILITY(P),
-        MIN_LOG_THRESHOLD(N)
-    {
-      // map candidates to results
-      results.insert(std::pair<Candidate, int>(Candidate::Mary, 0));
-      results.insert(std::pair<Candidate, int>(Candidate::John, 0));
-      results.insert(std::pair<Candidate, int>(Candidate::Anna, 0));
+    void setDiscipline(std::string mode) {
+      DISCIPLINE = mode;
+    }
 
-      // map candidates to names
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::Mary, "Mary"));
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::John, "John"));
-      candidates.insert(std::pair<Candidate, std::string>(Candidate::Anna, "Anna"));
+    void setTrace(const TraceReader* trace) {
+      this->trace = trace;
     }
 
-    static void* votersThread(void* arg) {
-      std::pair<Simulation*, time_t>* data = static_cast<std::pair<Simulation*, time_t>*>(arg);
-      data->first->simulateVoterArrival(data->second);
-      return NULL;
+    const std::vector<RunSummary>& getSummaries() {
+      return summaries;
     }
 
-    static void* stationThread(void* arg) {
-      std::tuple<PollingStation*, time_t, time_t>* data = static_cast<std::tuple<PollingStation*, time_t, time_t>*>(arg);
-      PollingStation* station = std::get<0>(*data);
-      time_t start = std::get<1>(*data);
-      time_t deadline = std::get<2>(*data);
-      station->simulate(start, deadline);
+  private:
+    static void* thread(void* arg) {
+      static_cast<BatchRunner*>(arg)->work();
       return NULL;
     }
 
-    PollingStation* getStationWithShortestQueue() {
-      PollingStation* station = stations[0];
-      for (int i = 1; i < NUM_STATIONS; i++) {
-        if (stations[i]->getQueueLength() < station->getQueueLength()) {
-          station = stations[i];
-        }
+    void work() {
+      int i;
+      while ((i = next.fetch_add(1)) < (int)configs.size()) {
+        const SweepConfig& config = configs[i];
+        simtime_t started = monotonic_now();
+        Simulation simulation(
+          seconds_to_ns(config.tick),
+          config.probability,
+          config.failureRate,
+          config.stations,
+          MIN_LOG_THRESHOLD,
+          config.ticks,
+          QUEUE_CAPACITY,
+          DISPATCH_MODE,
+          config.seed,
+          NUM_GENERATORS,
+          1,
+          "",
+          ballot
+        );
+        simulation.setQuiet(true);
+        simulation.setBatchSize(BATCH_SIZE);
+        simulation.setFailureModel(FAILURE_MODE);
+        simulation.setStealing(STEALING);
+        simulation.setDiscipline(DISCIPLINE);
+        simulation.setTrace(trace);
+        simulation.run(true);
+        simulation.summarize(summaries[i]);
+        summaries[i].elapsed = ns_to_seconds(monotonic_now() - started);
       }
-      return station;
     }
+};
 
-    void simulateVoterArrival(time_t deadline) {
-      while (difftime(deadline, time(NULL)) > 0) {
-        // enqueue voters
-        float probability = rand() / (float)RAND_MAX;
-        PollingStation* station = getStationWithShortestQueue();
-        VoterType type;
-        if (probability < VOTER_PROBABILITY) {
-          type = VoterType::Ordinary;
-        } else {
-          type = VoterType::Special;
-        }
-        // add to queue
-        Voter* voter = station->enqueue(type, deadline);
-        voter->stationId = station->getId();
-        history.push_back(voter);
-        // sleep
-        pthread_sleep(WAIT_TIME);
-      }
-      print("[Simulation] No more voters are coming!");
-    }
+// runs a virtual-time simulation in one process per shard, the shards
+// share the tally and their progress through a region of
+// shared memory and hand the rest of their results to the parent in a file
+// each, a shard that crashes only loses its own stations
+class ShardRunner {
 
-    void run() {
+  Simulation& simulation;
+  ShardRegion& region;
+  std::string LOG_PATH;
 
-      // get deadline for simulation
-      start_time = time(NULL);
-      deadline = time(NULL) + SIMULATION_TIME;
+  // the process and the results file of every shard
+  std::vector<pid_t> pids;
+  std::vector<FILE*> results;
 
-      // create polling stations
-      for (int i = 0; i < NUM_STATIONS; i++) {
-        PollingStation* station = new PollingStation(i, WAIT_TIME, FAILURE_RATE, MIN_LOG_THRESHOLD);
-        history.push_back(station->enqueue(VoterType::Special, deadline));
-        history.push_back(station->enqueue(VoterType::Ordinary, deadline));
-        stations.push_back(station);
+  public:
+    ShardRunner(Simulation& simulation, ShardRegion& region, std::string L)
+      : simulation(simulation), region(region), LOG_PATH(L) {}
+
+    // forks the shards, before the process starts any thread, returns the
+    // shard in a forked process and -1 in the parent
+    int start() {
+      simulation.setShards(&region);
+      fflush(stdout);
+      for (int s = 0; s < region.size(); s++) {
+        results.push_back(tmpfile());
+        pids.push_back(results[s] != NULL ? fork() : -1);
+        if (pids[s] == 0) {
+          return s;
+        }
+        if (pids[s] < 0) {
+          region.setState(s, ShardState::Failed);
+          print("[Simulation] Cannot start shard " + std::to_string(s));
+        }
       }
+      return -1;
+    }
 
-      print("[Simulation] Simulation started!");
-
-      // threads
-      pthread_t voterThread;
-      pthread_t *stationThreads = new pthread_t[NUM_STATIONS];
+    // runs a shard in the forked process and exits
+    void runShard(int shard) {
+      simulation.setShard(shard);
+      simulation.run(true);
+      region.setState(shard, ShardState::Done);
+      SnapshotWriter out;
+      out.open(results[shard]);
+      simulation.saveResults(out);
+      bool written = out.close();
+      logger.stop();
+      fflush(stdout);
+      _exit(written ? 0 : 1);
+    }
 
-      // create polling stations and their threads
-      for (int i = 0; i < NUM_STATIONS; i++) {
-        PollingStation* station = stations[i];
-        std::tuple<PollingStation*, time_t, time_t> stationThreadData = std::make_tuple(station, start_time, deadline);
-        pthread_create(&stationThreads[i], NULL, &Simulation::stationThread, &stationThreadData);
+    // waits for the shards, a shard that dies is no longer waited for at
+    // the progress reports, then prints the results of the shards
+    // that finished, returns how many did not
+    int finish() {
+      int running = 0;
+      for (int s = 0; s < (int)pids.size(); s++) {
+        running += pids[s] > 0;
       }
-
-      // create voter thread
-      std::pair<Simulation*, time_t> voterThreadData = std::make_pair(this, deadline);
-      pthread_create(&voterThread, NULL, &Simulation::votersThread, &voterThreadData);
-
-      // wait for threads to finish
-      pthread_join(voterThread, NULL);
-      for (int i = 0; i < NUM_STATIONS; i++) {
-        pthread_join(stationThreads[i], NULL);
+      while (running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+          break;
+        }
+        int s = std::find(pids.begin(), pids.end(), pid) - pids.begin();
+        if (s == (int)pids.size()) {
+          continue;
+        }
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          region.setState(s, ShardState::Failed);
+          std::string reason = WIFSIGNALED(status) ? " with signal " + std::to_string(WTERMSIG(status)) : "";
+          print("[Simulation] Shard " + std::to_string(s) + " failed" + reason);
+        }
       }
 
-      print("[Simulation] Simulation finished!");
-
-      // add results from polling stations
-      for (int i = 0; i < NUM_STATIONS; i++) {
-        std::map<Candidate, int> stationResults = stations[i]->getResults();
-        for (auto it = stationResults.begin(); it != stationResults.end(); it++) {
-          results[it->first] += it->second;
+      int failed = 0;
+      for (int s = 0; s < (int)results.size(); s++) {
+        bool finished = region.getState(s) == ShardState::Done && results[s] != NULL;
+        if (finished) {
+          rewind(results[s]);
+          SnapshotReader in;
+          in.open(results[s]);
+          finished = simulation.loadResults(in, s);
+        } else if (results[s] != NULL) {
+          fclose(results[s]);
         }
+        failed += !finished;
       }
-
-      // print results
-      printResults();
-
-      // output log
-      outputLog();
-
-    }
-
-    int getTotalVotes() {
-      int total = 0;
-      for (auto it = results.begin(); it != results.end(); it++) {
-        total += it->second;
+      mergeLogs();
+      if (failed > 0) {
+        print("[Simulation] " + std::to_string(failed) + " of " + std::to_string(region.size()) + " shards failed, the results only count their votes up to the failure");
       }
-      return total;
+      simulation.finish();
+      return failed;
     }
 
-    void printResults() {
-      print("Total votes: " + std::to_string(getTotalVotes()));
-      for (auto it = results.begin(); it != results.end(); it++) {
-        print(candidates[it->first] + ": " + std::to_string(it->second));
+  private:
+    // the voter logs of the shards one after the other behind one header,
+    // logview puts the records back in order
+    void mergeLogs() {
+      if (LOG_PATH.empty()) {
+        return;
       }
-    }
-
-    void outputLog() {
-      std::ofstream log;
-      log.open("voters.log");
-      log << std::left << std::setw(25) << "StationID.VoterID";
-      log << std::setw(15) << "Category";
-      log << std::setw(25) << "Request Time";
-      log << std::setw(25) << "Polling Station Time";
-      log << std::setw(25) << "Turnaround Time";
-      log << std::endl;
-      for (int i = 0; i < history.size(); i++) {
-        Voter* voter = history[i];
-        log << std::left << std::setw(25) << voter->getFormattedId();
-        log << std::setw(15) << voter->getFormattedType();
-        log << std::setw(25) << std::to_string((int)difftime(voter->requestTime, start_time));
-        log << std::setw(25) << std::to_string((int)difftime(voter->pollingTime, start_time));
-        log << std::setw(25) << std::to_string((int)difftime(voter->pollingTime, voter->requestTime));
-        log << std::endl;
+      FILE* out = fopen(LOG_PATH.c_str(), "wb");
+      if (out == NULL) {
+        print("[Simulation] Cannot open " + LOG_PATH);
+        return;
+      }
+      bool headed = false;
+      std::vector<VoterRecord> records(4096);
+      for (int s = 0; s < region.size(); s++) {
+        std::string path = simulation.getShardLog(s);
+        FILE* in = fopen(path.c_str(), "rb");
+        if (in == NULL) {
+          continue;
+        }
+        VoterLogHeader header;
+        if (fread(&header, sizeof(header), 1, in) == 1) {
+          if (!headed) {
+            fwrite(&header, sizeof(header), 1, out);
+            headed = true;
+          }
+          // whole records only, a crashed shard may leave half of one
+          size_t n;
+          while ((n = fread(records.data(), sizeof(VoterRecord), records.size(), in)) > 0) {
+            fwrite(records.data(), sizeof(VoterRecord), n, out);
+          }
+        }
+        fclose(in);
+        remove(path.c_str());
       }
-      log.close();
+      fclose(out);
     }
-
 };
 
 void print_usage() {
   print(
     "usage: " + \
     sysname + \
-    " -t <seconds> -p <probability> -f <failure_rate> -c <num_stations> -s <seed> -n <print_after_nth_second> -T <ticks>"
+    " -t <seconds, may be fractional> -p <probability> -f <failure_rate> -c <num_stations> -s <seed> -n <print_after_nth_second> -T <ticks> [-q <queue_capacity>] [-d scan|heap|p2c] [-g <generators>] [-w <workers>] [-o <voter_log>] [-l <log_flush_ms>] [-b] [-C <ballot_file>] [-v] [-L] [-H <latency_file>] [-M <stats_file>] [-I <export_seconds>] [-k <batch_size>] [-F periodic|exp] [-S] [-Q strict|fifo|aging|wfq] [-P <checkpoint_file> -K <checkpoint_seconds>] [-R <snapshot_file> -o <voter_log>] [-A <trace_file>] [-X <shards>] [-B <sweep_file> [-J]]"
   );
 }
 
+// turnaround with stealing against the same run without it
+void printSavings(const RunSummary& with, const RunSummary& without) {
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(4);
+  line << "[Rebalance] " << with.stolen << " voters stolen, " << with.votes << " votes against " << without.votes << " without stealing";
+  print(line.str());
+  const char* NAMES[] = { "mean", "p95", "p99" };
+  double withTimes[] = { with.meanTurnaround, with.p95Turnaround, with.p99Turnaround };
+  double withoutTimes[] = { without.meanTurnaround, without.p95Turnaround, without.p99Turnaround };
+  for (int i = 0; i < 3; i++) {
+    line.str("");
+    line << "[Rebalance] " << NAMES[i] << " turnaround " << withTimes[i] << " s against " << withoutTimes[i] << " s, saved " << withoutTimes[i] - withTimes[i] << " s";
+    if (withoutTimes[i] > 0) {
+      line << " (" << std::setprecision(1) << 100 * (withoutTimes[i] - withTimes[i]) / withoutTimes[i] << "%)" << std::setprecision(4);
+    }
+    print(line.str());
+  }
+}
+
+// ticks of a run that lasts until the last arrival of a trace
+int traceTicks(const TraceReader& trace, double tick) {
+  simtime_t ns = seconds_to_ns(tick);
+  return (int)((trace.getEnd() + ns - 1) / ns) + 1;
+}
+
 int main(int argc, char **argv) {
 
   // simulation parameters
-  int WAIT_TIME = 1;
+  double WAIT_TIME = 1;
   float PARAM_P = .5;
   float PARAM_F = .2;
   int NUM_STATIONS = 10;
   int AFTER_NTH = 20;
   int TICKS = 60;
+  int QUEUE_CAPACITY = 0;
+  bool VIRTUAL_TIME = false;
+  std::string DISPATCH_MODE = "heap";
+  std::string LOG_PATH = "voters.bin";
+  std::string BALLOT_PATH;
+  int NUM_GENERATORS = 1;
+  int NUM_WORKERS = sysconf(_SC_NPROCESSORS_ONLN);
+  int LOG_FLUSH_MS = 50;
+  bool DROP_VERBOSE = false;
+  std::string SWEEP_PATH;
+  bool LATENCY_REPORT = false;
+  std::string LATENCY_PATH;
+  std::string STATS_PATH;
+  double EXPORT_INTERVAL = 1;
+  int BATCH_SIZE = 1;
+  std::string FAILURE_MODE = "periodic";
+  bool STEALING = false;
+  std::string DISCIPLINE = "strict";
+  std::string CHECKPOINT_PATH;
+  double CHECKPOINT_INTERVAL = 0;
+  std::string RESUME_PATH;
+  std::string TRACE_PATH;
+  int SHARDS = 1;
+  bool JSON_SUMMARY = false;
 
   // randomizer seed
   unsigned SEED = time(NULL);
 
   // parse command line arguments
   int c;
-  while ((c = getopt(argc, argv, "t:p:f:s:c:n:T:")) != -1) {
+  std::string given;
+  while ((c = getopt(argc, argv, "t:p:f:s:c:n:T:q:d:g:w:o:l:bC:vB:JLH:M:I:k:F:SP:K:R:A:X:Q:")) != -1) {
+    given += (char)c;
     switch (c) {
     case 't':
-      WAIT_TIME = atoi(optarg);
+      WAIT_TIME = atof(optarg);
       break;
     case 'p':
       PARAM_P = atof(optarg);
@@ -489,26 +2001,321 @@ int main(int argc, char **argv) {
     case 'T':
       TICKS = atoi(optarg);
       break;
+    case 'q':
+      QUEUE_CAPACITY = atoi(optarg);
+      break;
+    case 'd':
+      DISPATCH_MODE = optarg;
+      if (!isDispatchMode(DISPATCH_MODE)) {
+        print_usage();
+        return 0;
+      }
+      break;
+    case 'g':
+      NUM_GENERATORS = atoi(optarg);
+      break;
+    case 'w':
+      NUM_WORKERS = atoi(optarg);
+      break;
+    case 'o':
+      LOG_PATH = optarg;
+      break;
+    case 'l':
+      LOG_FLUSH_MS = atoi(optarg);
+      break;
+    case 'b':
+      DROP_VERBOSE = true;
+      break;
+    case 'C':
+      BALLOT_PATH = optarg;
+      break;
+    case 'v':
+      VIRTUAL_TIME = true;
+      break;
+    case 'B':
+      SWEEP_PATH = optarg;
+      break;
+    case 'J':
+      JSON_SUMMARY = true;
+      break;
+    case 'L':
+      LATENCY_REPORT = true;
+      break;
+    case 'H':
+      LATENCY_PATH = optarg;
+      break;
+    case 'M':
+      STATS_PATH = optarg;
+      break;
+    case 'I':
+      EXPORT_INTERVAL = atof(optarg);
+      break;
+    case 'k':
+      BATCH_SIZE = atoi(optarg);
+      break;
+    case 'S':
+      STEALING = true;
+      break;
+    case 'P':
+      CHECKPOINT_PATH = optarg;
+      break;
+    case 'K':
+      CHECKPOINT_INTERVAL = atof(optarg);
+      break;
+    case 'R':
+      RESUME_PATH = optarg;
+      break;
+    case 'A':
+      TRACE_PATH = optarg;
+      break;
+    case 'X':
+      SHARDS = atoi(optarg);
+      break;
+    case 'Q':
+      DISCIPLINE = optarg;
+      if (!isDisciplineMode(DISCIPLINE)) {
+        print_usage();
+        return 0;
+      }
+      break;
+    case 'F':
+      FAILURE_MODE = optarg;
+      if (!isFailureMode(FAILURE_MODE)) {
+        print_usage();
+        return 0;
+      }
+      break;
     default:
       print_usage();
       return 0;
     }
   }
 
-  // set seed for random
-  srand(SEED);
+  // candidates, built in unless a ballot file is given
+  Ballot ballot;
+  std::string error;
+  if (!BALLOT_PATH.empty() && !ballot.load(BALLOT_PATH, error)) {
+    print(sysname + ": " + error);
+    return 1;
+  }
+
+  // a resumed run takes every flag it does not set from the snapshot, the
+  // structure of the run has to stay the same
+  if (!RESUME_PATH.empty()) {
+    SnapshotHeader header;
+    if (!readSnapshotHeader(RESUME_PATH, header, error)) {
+      print(sysname + ": " + error);
+      return 1;
+    }
+    std::string dispatch(header.dispatchMode, strnlen(header.dispatchMode, sizeof(header.dispatchMode)));
+    if ((given.find('t') != std::string::npos && seconds_to_ns(WAIT_TIME) != header.tick) ||
+        (given.find('c') != std::string::npos && NUM_STATIONS != header.stations) ||
+        (given.find('g') != std::string::npos && std::max(1, std::min(NUM_GENERATORS, header.stations)) != header.generators) ||
+        (given.find('q') != std::string::npos && QUEUE_CAPACITY != header.queueCapacity) ||
+        (given.find('d') != std::string::npos && DISPATCH_MODE != dispatch) ||
+        ballot.size() != header.candidates) {
+      print(sysname + ": " + RESUME_PATH + " was taken with other -t, -c, -g, -q, -d or ballot");
+      return 1;
+    }
+    // a branch writes a voter log of its own, the original run keeps its log
+    struct stat log;
+    if (given.find('o') == std::string::npos) {
+      print(sysname + ": a resumed run needs its own voter log, -o");
+      return 1;
+    }
+    if (!LOG_PATH.empty() && header.logInode != 0 && stat(LOG_PATH.c_str(), &log) == 0 &&
+        (uint64_t)log.st_dev == header.logDevice && (uint64_t)log.st_ino == header.logInode) {
+      print(sysname + ": " + LOG_PATH + " is the voter log of the run " + RESUME_PATH + " was taken from");
+      return 1;
+    }
+    WAIT_TIME = ns_to_seconds(header.tick);
+    NUM_STATIONS = header.stations;
+    NUM_GENERATORS = header.generators;
+    QUEUE_CAPACITY = header.queueCapacity;
+    DISPATCH_MODE = dispatch;
+    if (given.find('T') == std::string::npos) {
+      TICKS = (int)(header.simulationTime / header.tick);
+    }
+    if (given.find('p') == std::string::npos) {
+      PARAM_P = header.probability;
+    }
+    if (given.find('f') == std::string::npos) {
+      PARAM_F = header.failureRate;
+    }
+    if (given.find('F') == std::string::npos) {
+      FAILURE_MODE = std::string(header.failureMode, strnlen(header.failureMode, sizeof(header.failureMode)));
+    }
+    if (given.find('k') == std::string::npos) {
+      BATCH_SIZE = header.batchSize;
+    }
+    if (given.find('s') == std::string::npos) {
+      SEED = header.seed;
+    }
+    if (given.find('Q') == std::string::npos) {
+      DISCIPLINE = std::string(header.discipline, strnlen(header.discipline, sizeof(header.discipline)));
+    }
+    STEALING = STEALING || header.stealing;
+    VIRTUAL_TIME = true;
+  }
+  if (!CHECKPOINT_PATH.empty() && !VIRTUAL_TIME) {
+    print(sysname + ": checkpoints need virtual time, -v");
+    return 1;
+  }
+
+  // a trace replays in virtual time, by default on the stations it names
+  // until its last arrival, with queues sized for crowds the ticks do not
+  // predict
+  TraceReader trace;
+  if (!TRACE_PATH.empty()) {
+    if (!CHECKPOINT_PATH.empty() || !RESUME_PATH.empty()) {
+      print(sysname + ": traces cannot be checkpointed or resumed");
+      return 1;
+    }
+    if (!trace.open(TRACE_PATH, error)) {
+      print(sysname + ": " + error);
+      return 1;
+    }
+    if (given.find('c') == std::string::npos && trace.getStations() > 0) {
+      NUM_STATIONS = trace.getStations();
+    }
+    if (given.find('T') == std::string::npos) {
+      TICKS = traceTicks(trace, WAIT_TIME);
+    }
+    if (given.find('q') == std::string::npos) {
+      QUEUE_CAPACITY = DEFAULT_QUEUE_CAPACITY;
+    }
+    VIRTUAL_TIME = true;
+  }
+  const TraceReader* replay = TRACE_PATH.empty() ? NULL : &trace;
+
+  // a sharded run forks one process per shard, a shard runs whole
+  // generators with their slices in virtual time, one each by default
+  if (SHARDS > 1) {
+    if (!CHECKPOINT_PATH.empty() || !RESUME_PATH.empty() || !SWEEP_PATH.empty()) {
+      print(sysname + ": sharded runs cannot be checkpointed, resumed or swept");
+      return 1;
+    }
+    if (given.find('g') == std::string::npos) {
+      NUM_GENERATORS = SHARDS;
+    }
+    if (SHARDS > std::min(NUM_GENERATORS, NUM_STATIONS)) {
+      print(sysname + ": every shard needs a generator and a station, -X is at most -g and -c");
+      return 1;
+    }
+    VIRTUAL_TIME = true;
+  }
+
+  // batch mode, one summary row per configuration of the sweep
+  if (!SWEEP_PATH.empty()) {
+    SweepConfig base;
+    base.tick = WAIT_TIME;
+    base.probability = PARAM_P;
+    base.failureRate = PARAM_F;
+    base.stations = NUM_STATIONS;
+    base.ticks = TICKS;
+    base.seed = SEED;
+    std::vector<SweepConfig> configs;
+    if (!loadSweep(SWEEP_PATH, base, configs, error)) {
+      print(sysname + ": " + error);
+      return 1;
+    }
+    // runs that keep the default length replay the whole trace at any tick
+    for (int i = 0; replay != NULL && given.find('T') == std::string::npos && i < (int)configs.size(); i++) {
+      if (configs[i].ticks == base.ticks) {
+        configs[i].ticks = traceTicks(trace, configs[i].tick);
+      }
+    }
+    BatchRunner runner(configs, seconds_to_ns(AFTER_NTH), QUEUE_CAPACITY, DISPATCH_MODE, NUM_GENERATORS, &ballot);
+    runner.setBatchSize(BATCH_SIZE);
+    runner.setFailureModel(FAILURE_MODE);
+    runner.setStealing(STEALING);
+    runner.setDiscipline(DISCIPLINE);
+    runner.setTrace(replay);
+    runner.run(NUM_WORKERS);
+    writeSummaries(std::cout, configs, runner.getSummaries(), JSON_SUMMARY);
+    return 0;
+  }
 
   // create simulation
   Simulation simulation(
-    WAIT_TIME,
+    seconds_to_ns(WAIT_TIME),
     PARAM_P,
     PARAM_F,
     NUM_STATIONS,
-    AFTER_NTH,
-    TICKS
+    seconds_to_ns(AFTER_NTH),
+    TICKS,
+    QUEUE_CAPACITY,
+    DISPATCH_MODE,
+    SEED,
+    NUM_GENERATORS,
+    NUM_WORKERS,
+    LOG_PATH,
+    &ballot
   );
+  simulation.setLatencyReport(LATENCY_REPORT);
+  simulation.setLatencyExport(LATENCY_PATH);
+  simulation.setStatsExport(STATS_PATH);
+  simulation.setExportInterval(seconds_to_ns(EXPORT_INTERVAL));
+  simulation.setBatchSize(BATCH_SIZE);
+  simulation.setFailureModel(FAILURE_MODE);
+  simulation.setStealing(STEALING);
+  simulation.setDiscipline(DISCIPLINE);
+  simulation.setCheckpoint(CHECKPOINT_PATH, seconds_to_ns(CHECKPOINT_INTERVAL));
+  simulation.setResume(RESUME_PATH);
+  simulation.setTrace(replay);
+
+  // run simulation, the shards are forked before the logger starts its
+  // thread and every shard starts its own
+  ShardRegion region;
+  int failed = 0;
+  if (SHARDS > 1) {
+    if (!region.create("/" + sysname + "." + std::to_string(getpid()), SHARDS, NUM_STATIONS, ballot.size(), error)) {
+      print(sysname + ": " + error);
+      return 1;
+    }
+    ShardRunner runner(simulation, region, LOG_PATH);
+    int shard = runner.start();
+    logger.start(LOG_FLUSH_MS, DROP_VERBOSE);
+    if (shard >= 0) {
+      runner.runShard(shard);
+    }
+    failed = runner.finish();
+  } else {
+    logger.start(LOG_FLUSH_MS, DROP_VERBOSE);
+    simulation.run(VIRTUAL_TIME);
+  }
 
-  // run simulation
-  simulation.run();
+  // in virtual time the same seed reruns the election without stealing, the
+  // difference in turnaround is what rebalancing saved
+  if (STEALING && VIRTUAL_TIME && RESUME_PATH.empty()) {
+    Simulation baseline(
+      seconds_to_ns(WAIT_TIME),
+      PARAM_P,
+      PARAM_F,
+      NUM_STATIONS,
+      seconds_to_ns(AFTER_NTH),
+      TICKS,
+      QUEUE_CAPACITY,
+      DISPATCH_MODE,
+      SEED,
+      NUM_GENERATORS,
+      NUM_WORKERS,
+      "",
+      &ballot
+    );
+    baseline.setQuiet(true);
+    baseline.setBatchSize(BATCH_SIZE);
+    baseline.setFailureModel(FAILURE_MODE);
+    baseline.setDiscipline(DISCIPLINE);
+    baseline.setTrace(replay);
+    baseline.run(true);
+    RunSummary with;
+    RunSummary without;
+    simulation.summarize(with);
+    baseline.summarize(without);
+    printSavings(with, without);
+  }
+  logger.stop();
+  return failed > 0 ? 1 : 0;
 
 }
@@ -0,0 +1,143 @@
+#include "pool.hh"
+
+// index of the worker running on this thread, -1 elsewhere
+static thread_local int currentWorker = -1;
+
+WorkerPool::WorkerPool(int count, EventHandler* handler, simtime_t deadline, TimerWheel* clock)
+  : handler(handler),
+    deadline(deadline),
+    started(0),
+    stopped(0),
+    queued(0),
+    sleepers(0),
+    stopping(false),
+    clock(clock)
+{
+  for (int i = 0; i < count; i++) {
+    Worker* worker = new Worker();
+    worker->pool = this;
+    worker->index = i;
+    workers.push_back(worker);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  for (int i = 0; i < (int)workers.size(); i++) {
+    delete workers[i];
+  }
+}
+
+void WorkerPool::start() {
+  started = monotonic_now();
+  for (int i = 0; i < (int)workers.size(); i++) {
+    pthread_create(&workers[i]->thread, NULL, &WorkerPool::workerThread, workers[i]);
+  }
+}
+
+void WorkerPool::stop() {
+  stopping.store(true);
+  {
+    std::lock_guard<std::mutex> lock(sleepMtx);
+    sleepCond.notify_all();
+  }
+  for (int i = 0; i < (int)workers.size(); i++) {
+    pthread_join(workers[i]->thread, NULL);
+  }
+  stopped = monotonic_now();
+}
+
+void WorkerPool::push(simtime_t time, EventType type, int target) {
+  if (deadline - time <= 0) {
+    return;
+  }
+  Event event;
+  event.time = time;
+  event.seq = 0;
+  event.type = type;
+  event.target = target;
+  if (time - monotonic_now() > 0) {
+    clock->schedule(time, this, event);
+    return;
+  }
+  submit(event);
+}
+
+void WorkerPool::expire(const Event& event) {
+  // the workers may already be gone
+  if (!stopping.load()) {
+    submit(event);
+  }
+}
+
+void WorkerPool::submit(const Event& event) {
+  // keep work on the submitting worker, spread outside work by target
+  int index = currentWorker >= 0 ? currentWorker : event.target % (int)workers.size();
+  Worker* worker = workers[index];
+  {
+    std::lock_guard<std::mutex> lock(worker->mtx);
+    worker->tasks.push_back(event);
+  }
+  queued.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(sleepMtx);
+    sleepCond.notify_one();
+  }
+}
+
+bool WorkerPool::take(Worker* worker, Event& event) {
+  {
+    std::lock_guard<std::mutex> lock(worker->mtx);
+    if (!worker->tasks.empty()) {
+      event = worker->tasks.back();
+      worker->tasks.pop_back();
+      queued.fetch_sub(1);
+      return true;
+    }
+  }
+  int n = workers.size();
+  for (int i = 1; i < n; i++) {
+    Worker* victim = workers[(worker->index + i) % n];
+    std::lock_guard<std::mutex> lock(victim->mtx);
+    if (!victim->tasks.empty()) {
+      event = victim->tasks.front();
+      victim->tasks.pop_front();
+      queued.fetch_sub(1);
+      worker->stats.steals.store(worker->stats.steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void* WorkerPool::workerThread(void* arg) {
+  Worker* worker = static_cast<Worker*>(arg);
+  worker->pool->runWorker(worker);
+  return NULL;
+}
+
+void WorkerPool::runWorker(Worker* worker) {
+  currentWorker = worker->index;
+  Event event;
+  for (;;) {
+    if (take(worker, event)) {
+      simtime_t begin = monotonic_now();
+      handler->handle(event, begin, *this);
+      WorkerStats& stats = worker->stats;
+      stats.busy.store(stats.busy.load(std::memory_order_relaxed) + monotonic_now() - begin, std::memory_order_relaxed);
+      stats.tasks.store(stats.tasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMtx);
+    sleepers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (queued.load() == 0 && !stopping.load()) {
+      sleepCond.wait(lock);
+    }
+    sleepers.fetch_sub(1);
+    if (queued.load() == 0 && stopping.load()) {
+      break;
+    }
+  }
+  currentWorker = -1;
+}
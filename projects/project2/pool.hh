@@ -0,0 +1,92 @@
+#ifndef POOL_HH
+#define POOL_HH
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <pthread.h>
+#include "clock.hh"
+#include "events.hh"
+#include "timer.hh"
+
+
+ /******************************************************************************
+  work-stealing worker pool running station state machines on the wall clock
+  every worker owns a deque of due events, it takes work from the back of its
+  own deque and steals from the front of the others when it runs dry
+  events scheduled in the future wait on the shared timer wheel
+  events at or after the deadline are dropped, the stations are closed by then
+  *****************************************************************************/
+
+// per-worker statistics, only written by the worker, readable at any time
+struct WorkerStats {
+  std::atomic<simtime_t> busy{0};
+  std::atomic<long> tasks{0};
+  std::atomic<long> steals{0};
+};
+
+class WorkerPool : public Scheduler, public TimerTarget {
+
+  struct Worker {
+    WorkerPool* pool;
+    int index;
+    pthread_t thread;
+    std::deque<Event> tasks;
+    std::mutex mtx;
+    WorkerStats stats;
+  };
+
+  // workers
+  std::vector<Worker*> workers;
+  EventHandler* handler;
+  simtime_t deadline;
+  simtime_t started;
+  simtime_t stopped;
+
+  // sleeping workers
+  std::atomic<int> queued;
+  std::atomic<int> sleepers;
+  std::atomic<bool> stopping;
+  std::mutex sleepMtx;
+  std::condition_variable sleepCond;
+
+  // future events
+  TimerWheel* clock;
+
+  public:
+    WorkerPool(int workers, EventHandler* handler, simtime_t deadline, TimerWheel* clock);
+    ~WorkerPool();
+
+    void start();
+
+    // waits for the queued work to finish and joins all threads
+    void stop();
+
+    void push(simtime_t time, EventType type, int target);
+
+    // a future event is due
+    void expire(const Event& event);
+
+    int size() {
+      return workers.size();
+    }
+
+    const WorkerStats& getStats(int worker) {
+      return workers[worker]->stats;
+    }
+
+    // wall time between start() and stop()
+    simtime_t getElapsed() {
+      return stopped - started;
+    }
+
+  private:
+    static void* workerThread(void* arg);
+
+    void submit(const Event& event);
+    bool take(Worker* worker, Event& event);
+    void runWorker(Worker* worker);
+};
+
+#endif
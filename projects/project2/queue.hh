@@ -0,0 +1,334 @@
+#ifndef QUEUE_HH
+#define QUEUE_HH
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "clock.hh"
+#include "voter.hh"
+#include "arena.hh"
+#include "snapshot.hh"
+#include "discipline.hh"
+
+// waiting voters per priority level of a station, also the upper bound when
+// the simulation sizes queues itself
+const int DEFAULT_QUEUE_CAPACITY = 1024;
+
+ /******************************************************************************
+  bounded multi-producer multi-consumer ring (D. Vyukov's design)
+  every cell carries a sequence number that tells producers and consumers
+  whether it is free for the current lap, so neither side ever takes a lock
+  *****************************************************************************/
+template <typename T>
+class MPMCRing {
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  Cell* buffer;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+
+  public:
+    // capacity is rounded up to a power of two
+    MPMCRing(size_t capacity) : head(0), tail(0) {
+      size_t size = 2;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      buffer = new Cell[size];
+      mask = size - 1;
+      for (size_t i = 0; i < size; i++) {
+        buffer[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    ~MPMCRing() {
+      delete[] buffer;
+    }
+
+    bool push(T data) {
+      size_t pos = tail.load(std::memory_order_relaxed);
+      for (;;) {
+        Cell* cell = &buffer[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+          if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            cell->data = data;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          // full
+          return false;
+        } else {
+          pos = tail.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    bool pop(T& data) {
+      size_t pos = head.load(std::memory_order_relaxed);
+      for (;;) {
+        Cell* cell = &buffer[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+          if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            data = cell->data;
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          // empty
+          return false;
+        } else {
+          pos = head.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // the oldest element without taking it, false if the ring is empty, only
+    // exact while no other consumer pops, otherwise one may take it before
+    // the caller gets to
+    bool peek(T& data) {
+      size_t pos = head.load(std::memory_order_acquire);
+      Cell* cell = &buffer[pos & mask];
+      if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+      }
+      data = cell->data;
+      // the cell was taken and filled again while it was read
+      return cell->sequence.load(std::memory_order_acquire) == pos + 1 && head.load(std::memory_order_acquire) == pos;
+    }
+};
+
+ /******************************************************************************
+  station queue with one lock-free ring per voter type, in arrival order
+  within a type, a queue discipline picks the type served next, without one
+  the highest priority goes first
+  enqueues never take a lock, dequeues through a discipline take one per
+  call, so the heads the discipline looks at are still the heads when the
+  voter is taken and its state sees every voter served, the owner and a
+  stealing peer may dequeue at once
+  rings are allocated on first use, so unused voter types cost nothing
+  *****************************************************************************/
+class PollingQueue {
+  std::atomic<MPMCRing<VoterRef>*> rings[NUM_VOTER_TYPES];
+  VoterArena* arena;
+  size_t capacity;
+  alignas(64) std::atomic<int> count;
+  alignas(64) std::atomic<int> counter;
+  QueueDiscipline* discipline = NULL;
+  // one consumer at a time picks and takes through the discipline
+  std::mutex takeMtx;
+
+  public:
+    PollingQueue(VoterArena* arena, int capacity = DEFAULT_QUEUE_CAPACITY)
+      : arena(arena), capacity(capacity), count(0), counter(0)
+    {
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        rings[i].store(NULL, std::memory_order_relaxed);
+      }
+    }
+
+    ~PollingQueue() {
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        delete rings[i].load();
+      }
+      delete discipline;
+    }
+
+    // the queue owns the discipline, set before the first voter comes, NULL
+    // serves the highest priority first without a lock
+    void setDiscipline(QueueDiscipline* discipline) {
+      delete this->discipline;
+      this->discipline = discipline;
+    }
+
+    // returns NO_VOTER if the ring for this voter type or the arena is full,
+    // the record of a turned away voter goes back to the arena
+    VoterRef enqueue(VoterType type, int stationId, simtime_t now, simtime_t deadline) {
+      MPMCRing<VoterRef>* ring = getRing((int)type);
+      int id = counter.fetch_add(1, std::memory_order_relaxed);
+      VoterRef voter = arena->allocate(id, stationId, type, now, deadline);
+      if (voter == NO_VOTER) {
+        return NO_VOTER;
+      }
+      count.fetch_add(1, std::memory_order_relaxed);
+      if (!ring->push(voter)) {
+        count.fetch_sub(1, std::memory_order_relaxed);
+        arena->release(voter);
+        return NO_VOTER;
+      }
+      return voter;
+    }
+
+    // non-blocking dequeue, NO_VOTER if the queue is empty
+    VoterRef tryDequeue() {
+      if (count.load(std::memory_order_relaxed) <= 0) {
+        return NO_VOTER;
+      }
+      if (discipline != NULL) {
+        VoterRef voter;
+        return tryDequeue(&voter, 1) > 0 ? voter : NO_VOTER;
+      }
+      for (int i = NUM_VOTER_TYPES - 1; i >= 0; i--) {
+        MPMCRing<VoterRef>* ring = rings[i].load(std::memory_order_acquire);
+        VoterRef voter;
+        if (ring != NULL && ring->pop(voter)) {
+          count.fetch_sub(1, std::memory_order_relaxed);
+          return voter;
+        }
+      }
+      return NO_VOTER;
+    }
+
+    // takes up to max voters in the order of the discipline with a single
+    // update of the count, returns how many were taken
+    int tryDequeue(VoterRef* voters, int max) {
+      if (count.load(std::memory_order_relaxed) <= 0) {
+        return 0;
+      }
+      int taken = 0;
+      if (discipline != NULL) {
+        std::lock_guard<std::mutex> lock(takeMtx);
+        taken = takeInOrder(voters, max);
+      } else {
+        for (int i = NUM_VOTER_TYPES - 1; i >= 0 && taken < max; i--) {
+          MPMCRing<VoterRef>* ring = rings[i].load(std::memory_order_acquire);
+          while (ring != NULL && taken < max && ring->pop(voters[taken])) {
+            taken++;
+          }
+        }
+      }
+      if (taken > 0) {
+        count.fetch_sub(taken, std::memory_order_relaxed);
+      }
+      return taken;
+    }
+
+    bool empty() {
+      return size() == 0;
+    }
+
+    int size() {
+      return count.load(std::memory_order_relaxed);
+    }
+
+    // the waiting voters in queue order, the queue is the same afterwards,
+    // only while no other thread uses it
+    void save(SnapshotWriter& out) {
+      out.put((int32_t)counter.load(std::memory_order_relaxed));
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        MPMCRing<VoterRef>* ring = rings[i].load(std::memory_order_acquire);
+        std::vector<VoterRef> waiting;
+        VoterRef voter;
+        while (ring != NULL && ring->pop(voter)) {
+          waiting.push_back(voter);
+        }
+        out.put((int32_t)waiting.size());
+        for (int j = 0; j < (int)waiting.size(); j++) {
+          voter = waiting[j];
+          out.put((int32_t)arena->getId(voter));
+          out.put((int32_t)arena->getStationId(voter));
+          out.put(arena->getRequestTime(voter));
+          out.put(arena->getPollingTime(voter));
+          ring->push(voter);
+        }
+      }
+      std::vector<int64_t> state;
+      if (discipline != NULL) {
+        state = discipline->getState();
+      }
+      out.put((int32_t)state.size());
+      for (int i = 0; i < (int)state.size(); i++) {
+        out.put(state[i]);
+      }
+    }
+
+    // only into an empty queue
+    void load(SnapshotReader& in) {
+      counter.store(in.get<int32_t>(), std::memory_order_relaxed);
+      for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+        int32_t waiting = in.get<int32_t>();
+        for (int j = 0; j < waiting; j++) {
+          int32_t id = in.get<int32_t>();
+          int32_t stationId = in.get<int32_t>();
+          simtime_t requestTime = in.get<simtime_t>();
+          simtime_t pollingTime = in.get<simtime_t>();
+          if (!in.good()) {
+            return;
+          }
+          VoterRef voter = arena->allocate(id, stationId, (VoterType)i, requestTime, pollingTime);
+          if (voter == NO_VOTER) {
+            continue;
+          }
+          if (!getRing(i)->push(voter)) {
+            arena->release(voter);
+            continue;
+          }
+          count.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      std::vector<int64_t> state(std::max(0, in.get<int32_t>()));
+      for (int i = 0; i < (int)state.size() && in.good(); i++) {
+        state[i] = in.get<int64_t>();
+      }
+      if (discipline != NULL && in.good()) {
+        discipline->setState(state);
+      }
+    }
+
+  private:
+    // one voter at a time, the discipline looks at the oldest voter of
+    // every type before each, with takeMtx held
+    int takeInOrder(VoterRef* voters, int max) {
+      QueueHead heads[NUM_VOTER_TYPES];
+      int taken = 0;
+      while (taken < max) {
+        bool waiting = false;
+        for (int i = 0; i < NUM_VOTER_TYPES; i++) {
+          MPMCRing<VoterRef>* ring = rings[i].load(std::memory_order_acquire);
+          VoterRef head;
+          heads[i].waiting = ring != NULL && ring->peek(head);
+          if (heads[i].waiting) {
+            heads[i].sequence = arena->getId(head);
+            heads[i].request = arena->getRequestTime(head);
+            waiting = true;
+          }
+        }
+        if (!waiting) {
+          break;
+        }
+        // no other consumer pops while the lock is held, so the head is
+        // still there
+        int type = discipline->pick(heads);
+        if (!rings[type].load(std::memory_order_acquire)->pop(voters[taken])) {
+          break;
+        }
+        discipline->taken(type);
+        taken++;
+      }
+      return taken;
+    }
+
+    MPMCRing<VoterRef>* getRing(int level) {
+      MPMCRing<VoterRef>* ring = rings[level].load(std::memory_order_acquire);
+      if (ring != NULL) {
+        return ring;
+      }
+      MPMCRing<VoterRef>* created = new MPMCRing<VoterRef>(capacity);
+      if (rings[level].compare_exchange_strong(ring, created, std::memory_order_acq_rel)) {
+        return created;
+      }
+      delete created;
+      return ring;
+    }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef RNG_HH
+#define RNG_HH
+#include <stdint.h>
+
+
+ /******************************************************************************
+  small per-stream random number generator (xorshift64*)
+  every (seed, stream) pair is mixed through splitmix64 into an independent
+  starting state, so threads never share generator state or a lock and the
+  draws of a stream do not depend on how threads interleave
+  *****************************************************************************/
+
+// stream families, so station 3 and generator 3 never share a stream
+enum class RngStream : uint64_t { Arrival = 1, Station = 2, Dispatch = 3 };
+
+inline uint64_t splitmix64(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+class Rng {
+  uint64_t state;
+
+  public:
+    Rng(uint64_t seed = 0, RngStream family = RngStream::Arrival, uint64_t index = 0) {
+      state = splitmix64(splitmix64(seed) ^ ((uint64_t)family << 40 | index));
+      if (state == 0) {
+        state = 0x9E3779B97F4A7C15ULL;
+      }
+    }
+
+    uint64_t next() {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // uniform in [0, 1)
+    double uniform() {
+      return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // position of the stream, for snapshots
+    uint64_t getState() {
+      return state;
+    }
+
+    void setState(uint64_t state) {
+      this->state = state;
+    }
+
+    // uniform in [0, n)
+    uint32_t below(uint32_t n) {
+      return (uint32_t)(((next() >> 32) * n) >> 32);
+    }
+};
+
+#endif
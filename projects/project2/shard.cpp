@@ -0,0 +1,96 @@
+#include "shard.hh"
+#include "sleep.hh"
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// rounds up to whole cache lines so every part of the region starts on one
+static size_t toLines(size_t bytes) {
+  return (bytes + 63) / 64 * 64;
+}
+
+ShardRegion::~ShardRegion() {
+  // forked shards leave the region to the process that created it
+  if (memory == NULL || getpid() != creator) {
+    return;
+  }
+  delete tally;
+  munmap(memory, length);
+  close(fd);
+  shm_unlink(name.c_str());
+}
+
+bool ShardRegion::create(const std::string& name, int shards, int stations, int candidates, std::string& error) {
+  this->name = name;
+  this->shards = shards;
+  size_t statusBytes = toLines(sizeof(Status) * shards);
+  length = statusBytes + Tally::bytes(stations, candidates);
+
+  // open shared memory segment
+  fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+  if (fd == -1) {
+    error = "cannot open shared memory " + name;
+    return false;
+  }
+  creator = getpid();
+
+  // size it and map it for read-write
+  if (ftruncate(fd, length) == -1) {
+    error = "cannot size shared memory " + name;
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    error = "cannot map shared memory " + name;
+    memory = NULL;
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  char* base = static_cast<char*>(memory);
+  status = reinterpret_cast<Status*>(base);
+  for (int s = 0; s < shards; s++) {
+    new (&status[s]) Status();
+    status[s].clock.store(0, std::memory_order_relaxed);
+    for (int r = 0; r < 2; r++) {
+      status[s].progress[r].votes.store(0, std::memory_order_relaxed);
+      status[s].progress[r].longest.store(0, std::memory_order_relaxed);
+      status[s].progress[r].longestStation.store(0, std::memory_order_relaxed);
+    }
+    status[s].state.store((int32_t)ShardState::Running, std::memory_order_relaxed);
+  }
+  tally = new Tally(stations, candidates, base + statusBytes);
+  return true;
+}
+
+void ShardRegion::publish(int shard, int round, simtime_t clock, long votes, int longest, int station) {
+  Progress& progress = status[shard].progress[round % 2];
+  progress.votes.store(votes, std::memory_order_relaxed);
+  progress.longest.store(longest, std::memory_order_relaxed);
+  progress.longestStation.store(station, std::memory_order_relaxed);
+  status[shard].clock.store(clock, std::memory_order_release);
+}
+
+void ShardRegion::awaitProgress(simtime_t clock) {
+  for (int spins = 0; ; spins++) {
+    bool behind = false;
+    for (int s = 0; s < shards && !behind; s++) {
+      behind = getState(s) == ShardState::Running && status[s].clock.load(std::memory_order_acquire) - clock < 0;
+    }
+    if (!behind) {
+      return;
+    }
+    // shards are busy for a whole interval, so back off to a short sleep soon
+    if (spins < 64) {
+      sched_yield();
+    } else {
+      pthread_sleep_ns(20000);
+    }
+  }
+}
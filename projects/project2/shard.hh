@@ -0,0 +1,106 @@
+#ifndef SHARD_HH
+#define SHARD_HH
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <sys/types.h>
+#include "clock.hh"
+#include "tally.hh"
+
+
+ /******************************************************************************
+  memory shared by the processes of a sharded run
+  a sharded run splits the arrival generators, and the stations of their
+  slices, over one process per shard, every shard runs its part of the
+  election in virtual time
+  the parent creates one POSIX shared memory region before forking the
+  shards, the children inherit the mapping, it holds
+   - the tally of the whole election, each row written by the shard owning
+     the station
+   - the progress of every shard, the virtual time it reached, the votes it
+     had counted and its longest queue by then, and whether it is still
+     running
+  the first shard prints the progress of the whole run once per report
+  interval of virtual time, every shard publishes its progress then and
+  waits until every shard still running reached the same time, so the
+  report adds up counts of one time, shards that finished or crashed are
+  not waited for, a quiet run reports nothing and its shards never wait
+  a shard is at most one report ahead of the first shard, it waits at the
+  next one, so it publishes into two slots in turn and never overwrites
+  the counts the first shard is still reading
+  all fields are lock-free atomics, which work across processes
+  *****************************************************************************/
+
+enum class ShardState { Running, Done, Failed };
+
+class ShardRegion {
+
+  // the counts of a shard at one report
+  struct Progress {
+    std::atomic<long> votes;
+    std::atomic<int32_t> longest;
+    std::atomic<int32_t> longestStation;
+  };
+
+  // progress of one shard, a cache line each
+  struct alignas(64) Status {
+    std::atomic<int64_t> clock;
+    std::atomic<int32_t> state;
+    Progress progress[2];
+  };
+
+  std::string name;
+  pid_t creator = 0;
+  int fd = -1;
+  void* memory = NULL;
+  size_t length = 0;
+
+  int shards = 0;
+  Status* status = NULL;
+  Tally* tally = NULL;
+
+  public:
+    ~ShardRegion();
+
+    // creates, sizes and maps the region, returns false with error set
+    bool create(const std::string& name, int shards, int stations, int candidates, std::string& error);
+
+    // the tally of the whole election, in the region
+    Tally* getTally() {
+      return tally;
+    }
+
+    // the shard counted votes by virtual time clock, the report with
+    // number round, its longest queue was that long at that station
+    void publish(int shard, int round, simtime_t clock, long votes, int longest, int station);
+
+    // blocks until every running shard published its progress at clock
+    void awaitProgress(simtime_t clock);
+
+    long getVotes(int shard, int round) {
+      return status[shard].progress[round % 2].votes.load(std::memory_order_relaxed);
+    }
+
+    int getLongest(int shard, int round) {
+      return status[shard].progress[round % 2].longest.load(std::memory_order_relaxed);
+    }
+
+    int getLongestStation(int shard, int round) {
+      return status[shard].progress[round % 2].longestStation.load(std::memory_order_relaxed);
+    }
+
+    void setState(int shard, ShardState state) {
+      status[shard].state.store((int32_t)state, std::memory_order_release);
+    }
+
+    ShardState getState(int shard) {
+      return (ShardState)status[shard].state.load(std::memory_order_acquire);
+    }
+
+    int size() {
+      return shards;
+    }
+};
+
+#endif
@@ -1,25 +1,19 @@
 #include "sleep.hh"
+#include <errno.h>
 
 int pthread_sleep (int seconds) {
-   pthread_mutex_t mutex;
-   pthread_cond_t conditionvar;
-   struct timespec timetoexpire;
-   if(pthread_mutex_init(&mutex,NULL)) {
-      return -1;
-    }
-   if(pthread_cond_init(&conditionvar,NULL)) {
-      return -1;
-    }
-   struct timeval tp;
-   //When to expire is an absolute time, so get the current time and add //it to our delay time
-   gettimeofday(&tp, NULL);
-   timetoexpire.tv_sec = tp.tv_sec + seconds; timetoexpire.tv_nsec = tp.tv_usec * 1000;
+   return pthread_sleep_ns((simtime_t)seconds * NSEC_PER_SEC);
+}
 
-   pthread_mutex_lock (&mutex);
-   int res =  pthread_cond_timedwait(&conditionvar, &mutex, &timetoexpire);
-   pthread_mutex_unlock (&mutex);
-   pthread_mutex_destroy(&mutex);
-   pthread_cond_destroy(&conditionvar);
+int pthread_sleep_ns (simtime_t nanoseconds) {
+   // an absolute deadline, so a signal cutting the sleep short resumes it
+   simtime_t expire = monotonic_now() + nanoseconds;
+   struct timespec timetoexpire;
+   timetoexpire.tv_sec = expire / NSEC_PER_SEC;
+   timetoexpire.tv_nsec = expire % NSEC_PER_SEC;
+   int res;
+   while ((res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &timetoexpire, NULL)) == EINTR) {
+   }
 
    // Upon successful completion, a value of zero shall be returned
    return res;
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include "clock.hh"
 
 
  /******************************************************************************
@@ -13,4 +14,9 @@
   *****************************************************************************/
 int pthread_sleep (int seconds);
 
+// same as pthread_sleep with nanosecond resolution on the monotonic clock
+// a single clock_nanosleep, threads of the simulation wait on the timer
+// wheel instead, see timer.hh
+int pthread_sleep_ns (simtime_t nanoseconds);
+
 #endif
@@ -0,0 +1,140 @@
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "clock.hh"
+
+
+ /******************************************************************************
+  snapshots of a virtual-time simulation
+  a header with the configuration and the virtual clock, followed by the
+  pending events, the arrival generators and the stations, each writing its
+  own state, only live data is written: waiting voters, buckets of the
+  latency histograms that counted something, the random stream positions
+  a run resumed from a snapshot continues exactly where the snapshot was
+  taken, or with other rates as a what-if branch of it
+  *****************************************************************************/
+
+const char SNAPSHOT_MAGIC[4] = { 'V', 'S', 'N', 'P' };
+const uint32_t SNAPSHOT_VERSION = 3;
+
+struct SnapshotHeader {
+  char magic[4];
+  uint32_t version;
+  // virtual time the snapshot was taken at
+  int64_t clock;
+  // the structure of the run, a resumed run has to keep it
+  int64_t tick;
+  int32_t stations;
+  int32_t generators;
+  int32_t queueCapacity;
+  int32_t candidates;
+  char dispatchMode[8];
+  // the behaviour of the run, a resumed run may change it
+  int64_t simulationTime;
+  float probability;
+  float failureRate;
+  char failureMode[12];
+  int32_t batchSize;
+  uint32_t seed;
+  uint8_t stealing;
+  uint8_t reserved[7];
+  char discipline[8];
+  // the voter log file of the run, 0 without one, a resumed run must not
+  // write over it
+  uint64_t logDevice;
+  uint64_t logInode;
+};
+
+class SnapshotWriter {
+  FILE* file = NULL;
+
+  public:
+    ~SnapshotWriter() {
+      if (file != NULL) {
+        fclose(file);
+      }
+    }
+
+    bool open(const char* path) {
+      file = fopen(path, "wb");
+      return file != NULL;
+    }
+
+    // writes into an open file, closed with the writer
+    void open(FILE* file) {
+      this->file = file;
+    }
+
+    template<typename T>
+    void put(const T& value) {
+      fwrite(&value, sizeof(T), 1, file);
+    }
+
+    // false if anything failed to be written
+    bool close() {
+      bool ok = ferror(file) == 0;
+      ok = fclose(file) == 0 && ok;
+      file = NULL;
+      return ok;
+    }
+};
+
+class SnapshotReader {
+  FILE* file = NULL;
+  bool failed = false;
+
+  public:
+    ~SnapshotReader() {
+      if (file != NULL) {
+        fclose(file);
+      }
+    }
+
+    bool open(const char* path) {
+      file = fopen(path, "rb");
+      return file != NULL;
+    }
+
+    // reads an open file from where it is, closed with the reader
+    void open(FILE* file) {
+      this->file = file;
+    }
+
+    // a zero value once the file is short, see good()
+    template<typename T>
+    T get() {
+      T value = T();
+      if (fread(&value, sizeof(T), 1, file) != 1) {
+        failed = true;
+      }
+      return value;
+    }
+
+    bool good() {
+      return !failed;
+    }
+};
+
+// reads and checks the header of a snapshot, returns false with error set
+inline bool readSnapshotHeader(const std::string& path, SnapshotHeader& header, std::string& error) {
+  SnapshotReader reader;
+  if (!reader.open(path.c_str())) {
+    error = "cannot open " + path;
+    return false;
+  }
+  header = reader.get<SnapshotHeader>();
+  if (!reader.good() || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+    error = path + " is not a snapshot";
+    return false;
+  }
+  if (header.version != SNAPSHOT_VERSION) {
+    error = path + " has snapshot version " + std::to_string(header.version) + ", expected " + std::to_string(SNAPSHOT_VERSION);
+    return false;
+  }
+  return true;
+}
+
+#endif
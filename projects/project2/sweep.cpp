@@ -0,0 +1,183 @@
+#include "sweep.hh"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+
+// the values of one flag, "a,b,c" and "start:stop[:step]" items
+static bool parseValues(const std::string& list, std::vector<double>& values) {
+  std::istringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    std::istringstream parts(item);
+    std::string part;
+    std::vector<double> range;
+    while (std::getline(parts, part, ':')) {
+      char* end = NULL;
+      double value = strtod(part.c_str(), &end);
+      if (part.empty() || *end != '\0') {
+        return false;
+      }
+      range.push_back(value);
+    }
+    if (range.size() == 1) {
+      values.push_back(range[0]);
+      continue;
+    }
+    if (range.size() > 3) {
+      return false;
+    }
+    double step = range.size() == 3 ? range[2] : 1;
+    if (step <= 0 || range[1] < range[0]) {
+      return false;
+    }
+    // counted rather than accumulated so 0.1 steps do not drift
+    long count = (long)floor((range[1] - range[0]) / step + 1e-9) + 1;
+    for (long i = 0; i < count; i++) {
+      values.push_back(range[0] + i * step);
+    }
+  }
+  return !values.empty();
+}
+
+bool loadSweep(const std::string& path, const SweepConfig& base, std::vector<SweepConfig>& configs, std::string& error) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  const std::string FLAGS = "tpfcTs";
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+
+    // values of every flag, the base value unless the line sets it
+    std::vector<std::vector<double>> values(FLAGS.size());
+    values[0].push_back(base.tick);
+    values[1].push_back(base.probability);
+    values[2].push_back(base.failureRate);
+    values[3].push_back(base.stations);
+    values[4].push_back(base.ticks);
+    values[5].push_back(base.seed);
+
+    std::istringstream tokens(line);
+    std::string flag;
+    std::string list;
+    bool empty = true;
+    while (tokens >> flag) {
+      empty = false;
+      size_t index = flag.size() == 2 && flag[0] == '-' ? FLAGS.find(flag[1]) : std::string::npos;
+      if (index == std::string::npos) {
+        error = where + "unknown flag " + flag;
+        return false;
+      }
+      std::vector<double> parsed;
+      if (!(tokens >> list) || !parseValues(list, parsed)) {
+        error = where + "bad values for " + flag;
+        return false;
+      }
+      values[index] = parsed;
+    }
+    if (empty) {
+      continue;
+    }
+
+    // every combination, the last flag varying fastest
+    std::vector<size_t> at(FLAGS.size(), 0);
+    for (;;) {
+      SweepConfig config;
+      config.tick = values[0][at[0]];
+      config.probability = values[1][at[1]];
+      config.failureRate = values[2][at[2]];
+      config.stations = (int)values[3][at[3]];
+      config.ticks = (int)values[4][at[4]];
+      config.seed = (unsigned)values[5][at[5]];
+      if (config.tick <= 0 || config.stations <= 0 || config.ticks <= 0) {
+        error = where + "-t, -c and -T must be positive";
+        return false;
+      }
+      configs.push_back(config);
+      int i = FLAGS.size() - 1;
+      while (i >= 0 && ++at[i] == values[i].size()) {
+        at[i] = 0;
+        i--;
+      }
+      if (i < 0) {
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void writeSummaries(std::ostream& out, const std::vector<SweepConfig>& configs, const std::vector<RunSummary>& summaries, bool json) {
+  // the tail turnaround of every voter type follows the overall one
+  std::vector<std::string> NAMES = {
+    "run", "t", "p", "f", "c", "T", "seed", "votes", "turned_away", "failures", "stolen",
+    "throughput", "mean_turnaround", "p95_turnaround", "p99_turnaround"
+  };
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    NAMES.push_back(std::string("p99_turnaround_") + VOTER_TYPE_CODES[t]);
+  }
+  NAMES.push_back("elapsed");
+  const int COLUMNS = NAMES.size();
+
+  if (json) {
+    out << "[" << std::endl;
+  } else {
+    for (int i = 0; i < COLUMNS; i++) {
+      out << (i > 0 ? "," : "") << NAMES[i];
+    }
+    out << std::endl;
+  }
+
+  for (int r = 0; r < (int)configs.size(); r++) {
+    const SweepConfig& config = configs[r];
+    const RunSummary& summary = summaries[r];
+    std::vector<std::ostringstream> fields(COLUMNS);
+    fields[0] << r;
+    fields[1] << config.tick;
+    fields[2] << config.probability;
+    fields[3] << config.failureRate;
+    fields[4] << config.stations;
+    fields[5] << config.ticks;
+    fields[6] << config.seed;
+    fields[7] << summary.votes;
+    fields[8] << summary.turnedAway;
+    fields[9] << summary.failures;
+    fields[10] << summary.stolen;
+    fields[11] << std::fixed << std::setprecision(4) << summary.throughput;
+    fields[12] << std::fixed << std::setprecision(4) << summary.meanTurnaround;
+    fields[13] << std::fixed << std::setprecision(4) << summary.p95Turnaround;
+    fields[14] << std::fixed << std::setprecision(4) << summary.p99Turnaround;
+    for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+      fields[15 + t] << std::fixed << std::setprecision(4) << summary.p99TurnaroundByType[t];
+    }
+    fields[COLUMNS - 1] << std::fixed << std::setprecision(4) << summary.elapsed;
+
+    if (json) {
+      out << "  {";
+      for (int i = 0; i < COLUMNS; i++) {
+        out << (i > 0 ? ", " : "") << "\"" << NAMES[i] << "\": " << fields[i].str();
+      }
+      out << "}" << (r + 1 < (int)configs.size() ? "," : "") << std::endl;
+    } else {
+      for (int i = 0; i < COLUMNS; i++) {
+        out << (i > 0 ? "," : "") << fields[i].str();
+      }
+      out << std::endl;
+    }
+  }
+
+  if (json) {
+    out << "]" << std::endl;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef SWEEP_HH
+#define SWEEP_HH
+#include <string>
+#include <vector>
+#include <ostream>
+#include "voter.hh"
+
+
+ /******************************************************************************
+  parameter sweeps for batch runs
+  a sweep file lists one configuration per line as simulation flags, any of
+  -t -p -f -c -T -s, flags left out keep their command line value
+  a flag may take several values, "a,b,c" or "start:stop[:step]", and the
+  line then expands to the grid of every combination, e.g.
+    -p 0.4:0.6:0.1 -c 10,20 -s 1:5
+  is 30 runs, blank lines and # comments are ignored
+  *****************************************************************************/
+
+struct SweepConfig {
+  double tick;
+  float probability;
+  float failureRate;
+  int stations;
+  int ticks;
+  unsigned seed;
+};
+
+// what a batch run reports, times in seconds
+struct RunSummary {
+  long votes = 0;
+  long turnedAway = 0;
+  long failures = 0;
+  // voters served by a station other than the one they queued at
+  long stolen = 0;
+  // votes per simulated second
+  double throughput = 0;
+  double meanTurnaround = 0;
+  double p95Turnaround = 0;
+  double p99Turnaround = 0;
+  double p99TurnaroundByType[NUM_VOTER_TYPES] = {};
+  // wall clock time of the run
+  double elapsed = 0;
+};
+
+// appends the configurations of the file to configs, base supplies the
+// flags a line leaves out, returns false with error set on a bad file
+bool loadSweep(const std::string& path, const SweepConfig& base, std::vector<SweepConfig>& configs, std::string& error);
+
+// one row per run, as csv with a header line or as a json array
+void writeSummaries(std::ostream& out, const std::vector<SweepConfig>& configs, const std::vector<RunSummary>& summaries, bool json);
+
+#endif
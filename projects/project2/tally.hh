@@ -0,0 +1,114 @@
+#ifndef TALLY_HH
+#define TALLY_HH
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "voter.hh"
+
+
+ /******************************************************************************
+  election results counted in place
+  every station owns whole cache lines of counters indexed by candidate, only the
+  station writes to it, so a vote is a plain load and store with no locking
+  and stations never share a line
+  any thread can read a station's count or the live totals at any time, the
+  totals are summed over the stations on demand
+  the counters may also live in memory the tally does not own, such as a
+  region shared by the processes of a sharded run, see shard.hh
+  *****************************************************************************/
+class Tally {
+
+  // counters of station i start at i * stride, a multiple of a cache line
+  std::atomic<long>* votes;
+  int stations;
+  int candidates;
+  int stride;
+  bool owned;
+
+  public:
+    Tally(int stations, int candidates) : stations(stations), candidates(candidates), stride(getStride(candidates)), owned(true) {
+      void* memory = NULL;
+      if (posix_memalign(&memory, 64, bytes(stations, candidates)) != 0) {
+        throw std::bad_alloc();
+      }
+      clear(memory);
+    }
+
+    // counters in memory of at least bytes() aligned to a cache line, left
+    // to the caller to free
+    Tally(int stations, int candidates, void* memory) : stations(stations), candidates(candidates), stride(getStride(candidates)), owned(false) {
+      clear(memory);
+    }
+
+    ~Tally() {
+      if (owned) {
+        free(votes);
+      }
+    }
+
+    static size_t bytes(int stations, int candidates) {
+      return sizeof(std::atomic<long>) * getStride(candidates) * stations;
+    }
+
+    // counts a vote at a station, only called by that station's handlers,
+    // returns the station's new count for the candidate
+    long cast(int station, Candidate candidate) {
+      std::atomic<long>& counter = votes[station * stride + (int)candidate];
+      long count = counter.load(std::memory_order_relaxed) + 1;
+      counter.store(count, std::memory_order_relaxed);
+      return count;
+    }
+
+    // counts n votes at once, same rules as cast()
+    long add(int station, Candidate candidate, long n) {
+      std::atomic<long>& counter = votes[station * stride + (int)candidate];
+      long count = counter.load(std::memory_order_relaxed) + n;
+      counter.store(count, std::memory_order_relaxed);
+      return count;
+    }
+
+    long get(int station, Candidate candidate) {
+      return votes[station * stride + (int)candidate].load(std::memory_order_relaxed);
+    }
+
+    // live total of a candidate over all stations
+    long total(Candidate candidate) {
+      long sum = 0;
+      for (int i = 0; i < stations; i++) {
+        sum += get(i, candidate);
+      }
+      return sum;
+    }
+
+    // live total of all votes
+    long total() {
+      long sum = 0;
+      for (int c = 0; c < candidates; c++) {
+        sum += total((Candidate)c);
+      }
+      return sum;
+    }
+
+    int size() {
+      return stations;
+    }
+
+    int getCandidates() {
+      return candidates;
+    }
+
+  private:
+    static int getStride(int candidates) {
+      const int PER_LINE = 64 / sizeof(long);
+      return ((candidates + PER_LINE - 1) / PER_LINE) * PER_LINE;
+    }
+
+    void clear(void* memory) {
+      votes = static_cast<std::atomic<long>*>(memory);
+      for (int i = 0; i < stride * stations; i++) {
+        votes[i].store(0, std::memory_order_relaxed);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "timer.hh"
+#include <chrono>
+#include <algorithm>
+
+TimerWheel::TimerWheel(simtime_t resolution, simtime_t origin)
+  : resolution(resolution > 0 ? resolution : 1),
+    origin(origin),
+    current(0),
+    nextTick(INT64_MAX),
+    counter(NO_TIMER),
+    running(false),
+    stopping(false)
+{
+  for (int level = 0; level < LEVELS; level++) {
+    for (int slot = 0; slot < SLOTS; slot++) {
+      slots[level][slot].prev = slots[level][slot].next = &slots[level][slot];
+    }
+  }
+  overflow.prev = overflow.next = &overflow;
+}
+
+TimerWheel::~TimerWheel() {
+  stop();
+}
+
+void TimerWheel::start() {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (!running && !stopping) {
+    running = true;
+    pthread_create(&thread, NULL, &TimerWheel::timerLoop, this);
+  }
+}
+
+void TimerWheel::stop() {
+  bool join;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+    join = running;
+    running = false;
+    cond.notify_all();
+  }
+  if (join) {
+    pthread_join(thread, NULL);
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  for (std::unordered_map<TimerId, Timer*>::iterator it = timers.begin(); it != timers.end(); ++it) {
+    Timer* timer = it->second;
+    if (timer->sleeper != NULL) {
+      timer->sleeper->cond.notify_one();
+    }
+    unlink(timer);
+    delete timer;
+  }
+  timers.clear();
+}
+
+TimerId TimerWheel::schedule(simtime_t due, TimerTarget* target, const Event& event) {
+  std::lock_guard<std::mutex> lock(mtx);
+  return add(due, target, event, NULL);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::unordered_map<TimerId, Timer*>::iterator it = timers.find(id);
+  if (it == timers.end()) {
+    return false;
+  }
+  // a sleeper's timer is only ever removed by firing or stop()
+  if (it->second->sleeper != NULL) {
+    return false;
+  }
+  unlink(it->second);
+  delete it->second;
+  timers.erase(it);
+  return true;
+}
+
+bool TimerWheel::sleepUntil(simtime_t due) {
+  std::unique_lock<std::mutex> lock(mtx);
+  if (stopping) {
+    return false;
+  }
+  Sleeper sleeper;
+  Event event = Event();
+  if (add(due, NULL, event, &sleeper) == NO_TIMER) {
+    return true;
+  }
+  while (!sleeper.woken && !stopping) {
+    sleeper.cond.wait(lock);
+  }
+  return sleeper.woken;
+}
+
+void TimerWheel::advance(simtime_t now) {
+  if (now - origin < 0) {
+    return;
+  }
+  Timer* expired;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    expired = collect((now - origin) / resolution);
+  }
+  fire(expired);
+}
+
+int TimerWheel::size() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return timers.size();
+}
+
+void* TimerWheel::timerLoop(void* arg) {
+  static_cast<TimerWheel*>(arg)->run();
+  return NULL;
+}
+
+void TimerWheel::run() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while (!stopping) {
+    if (nextTick == INT64_MAX) {
+      cond.wait(lock);
+      continue;
+    }
+    simtime_t wake = origin + nextTick * resolution;
+    simtime_t now = monotonic_now();
+    if (wake - now > 0) {
+      cond.wait_until(
+        lock,
+        std::chrono::steady_clock::time_point(std::chrono::nanoseconds(wake))
+      );
+      continue;
+    }
+    Timer* expired = collect((now - origin) / resolution);
+    lock.unlock();
+    fire(expired);
+    lock.lock();
+  }
+}
+
+TimerWheel::Timer* TimerWheel::collect(int64_t target) {
+  Timer* expired = NULL;
+  Timer** last = &expired;
+  while (current < target) {
+    // ticks before nextTick have nothing to fire or cascade
+    if (nextTick > target) {
+      current = target;
+      break;
+    }
+    current = nextTick;
+
+    // timers of the slots starting at this tick move down, from the top
+    if ((current & (((int64_t)1 << (SLOT_BITS * LEVELS)) - 1)) == 0) {
+      cascade(&overflow);
+    }
+    for (int level = LEVELS - 1; level > 0; level--) {
+      int shift = SLOT_BITS * level;
+      if ((current & (((int64_t)1 << shift) - 1)) == 0) {
+        cascade(&slots[level][(current >> shift) & (SLOTS - 1)]);
+      }
+    }
+
+    // level 0 holds the timers of exactly this tick
+    Timer* list = &slots[0][current & (SLOTS - 1)];
+    while (!empty(list)) {
+      Timer* timer = list->next;
+      unlink(timer);
+      timers.erase(timer->id);
+      if (timer->sleeper != NULL) {
+        timer->sleeper->woken = true;
+        timer->sleeper->cond.notify_one();
+        delete timer;
+        continue;
+      }
+      timer->next = NULL;
+      *last = timer;
+      last = &timer->next;
+    }
+    nextTick = findNextTick();
+  }
+  return expired;
+}
+
+void TimerWheel::fire(Timer* expired) {
+  while (expired != NULL) {
+    Timer* timer = expired;
+    expired = expired->next;
+    timer->target->expire(timer->event);
+    delete timer;
+  }
+}
+
+TimerId TimerWheel::add(simtime_t due, TimerTarget* target, const Event& event, Sleeper* sleeper) {
+  // the first tick at or after due, a timer of a tick already processed
+  // fires at the next one, a sleeper does not wait at all
+  int64_t tick = due - origin <= 0 ? 0 : (due - origin + resolution - 1) / resolution;
+  if (tick <= current) {
+    if (sleeper != NULL) {
+      return NO_TIMER;
+    }
+    tick = current + 1;
+  }
+  Timer* timer = new Timer();
+  timer->id = ++counter;
+  timer->tick = tick;
+  timer->event = event;
+  timer->target = target;
+  timer->sleeper = sleeper;
+  int64_t before = nextTick;
+  insert(timer);
+  timers[timer->id] = timer;
+  if (running && nextTick < before) {
+    cond.notify_one();
+  }
+  return timer->id;
+}
+
+void TimerWheel::insert(Timer* timer) {
+  // the lowest level whose slot span holds both the timer and the current
+  // tick, the slot is then always ahead of the current one
+  for (int level = 0; level < LEVELS; level++) {
+    int shift = SLOT_BITS * level;
+    if ((timer->tick >> (shift + SLOT_BITS)) == (current >> (shift + SLOT_BITS))) {
+      append(&slots[level][(timer->tick >> shift) & (SLOTS - 1)], timer);
+      int64_t start = level == 0 ? timer->tick : (timer->tick >> shift) << shift;
+      nextTick = std::min(nextTick, start);
+      return;
+    }
+  }
+  append(&overflow, timer);
+  int shift = SLOT_BITS * LEVELS;
+  nextTick = std::min(nextTick, ((current >> shift) + 1) << shift);
+}
+
+void TimerWheel::cascade(Timer* list) {
+  Timer moved;
+  moved.prev = moved.next = &moved;
+  while (!empty(list)) {
+    Timer* timer = list->next;
+    unlink(timer);
+    append(&moved, timer);
+  }
+  while (!empty(&moved)) {
+    Timer* timer = moved.next;
+    unlink(timer);
+    insert(timer);
+  }
+}
+
+int64_t TimerWheel::findNextTick() {
+  int64_t best = INT64_MAX;
+  for (int level = 0; level < LEVELS; level++) {
+    int shift = SLOT_BITS * level;
+    int index = (current >> shift) & (SLOTS - 1);
+    for (int slot = index + 1; slot < SLOTS; slot++) {
+      if (!empty(&slots[level][slot])) {
+        int64_t block = (current >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+        best = std::min(best, block + ((int64_t)slot << shift));
+        break;
+      }
+    }
+  }
+  if (!empty(&overflow)) {
+    int shift = SLOT_BITS * LEVELS;
+    best = std::min(best, ((current >> shift) + 1) << shift);
+  }
+  return best;
+}
+
+void TimerWheel::append(Timer* list, Timer* timer) {
+  timer->prev = list->prev;
+  timer->next = list;
+  list->prev->next = timer;
+  list->prev = timer;
+}
+
+void TimerWheel::unlink(Timer* timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = timer->next = timer;
+}
+
+bool TimerWheel::empty(Timer* list) {
+  return list->next == list;
+}
@@ -0,0 +1,130 @@
+#ifndef TIMER_HH
+#define TIMER_HH
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <pthread.h>
+#include "clock.hh"
+#include "events.hh"
+
+
+ /******************************************************************************
+  hierarchical timer wheel shared by everything that waits on the clock
+  time is cut into ticks of a fixed resolution, level 0 holds the next 64
+  ticks one slot each, every level above holds 64 slots of 64 times the
+  span of the level below, timers move down a level when the wheel reaches
+  their slot, timers beyond the top level wait in an overflow list
+  scheduling and cancelling are O(1), a timer fires at the first tick at
+  or after its due time, never early and at most one resolution late
+  a timer either hands an event to a target or wakes a sleeping thread, one
+  timer thread serves all of them on the monotonic clock after start(), or
+  the owner drives the wheel on a virtual clock with advance() and no
+  thread runs at all
+  stop() cancels every timer and wakes every sleeper, so threads waiting on
+  the wheel can be shut down early
+  *****************************************************************************/
+
+// anything a timer can fire an event into, called on the timer thread or
+// the thread calling advance(), never with the wheel locked
+class TimerTarget {
+  public:
+    virtual ~TimerTarget() {}
+    virtual void expire(const Event& event) = 0;
+};
+
+typedef uint64_t TimerId;
+const TimerId NO_TIMER = 0;
+
+class TimerWheel {
+
+  static const int LEVELS = 8;
+  static const int SLOT_BITS = 6;
+  static const int SLOTS = 1 << SLOT_BITS;
+
+  // a thread blocked in sleepUntil()
+  struct Sleeper {
+    std::condition_variable cond;
+    bool woken = false;
+  };
+
+  // timers are linked into their slot, every slot and the overflow list is
+  // a circular list around an empty timer
+  struct Timer {
+    TimerId id;
+    int64_t tick;
+    Event event;
+    TimerTarget* target;
+    Sleeper* sleeper;
+    Timer* prev;
+    Timer* next;
+  };
+
+  simtime_t resolution;
+  simtime_t origin;
+
+  // ticks since origin the wheel has processed, and the first tick any
+  // slot needs to be looked at again, never later than the real one
+  int64_t current;
+  int64_t nextTick;
+
+  Timer slots[LEVELS][SLOTS];
+  Timer overflow;
+  std::unordered_map<TimerId, Timer*> timers;
+  TimerId counter;
+
+  std::mutex mtx;
+  std::condition_variable cond;
+  pthread_t thread;
+  bool running;
+  bool stopping;
+
+  public:
+    // ticks of resolution ns starting at origin
+    TimerWheel(simtime_t resolution, simtime_t origin);
+    ~TimerWheel();
+
+    // follows the monotonic clock on a timer thread
+    void start();
+
+    // joins the timer thread, drops every timer and wakes every sleeper
+    void stop();
+
+    // target->expire(event) once the clock reaches due
+    TimerId schedule(simtime_t due, TimerTarget* target, const Event& event);
+
+    // false if the timer already fired or was cancelled
+    bool cancel(TimerId id);
+
+    // blocks the calling thread until the wheel reaches due, false if it
+    // was woken early by stop()
+    bool sleepUntil(simtime_t due);
+
+    // fires every timer due at or before now, for wheels on a virtual clock
+    void advance(simtime_t now);
+
+    // timers waiting to fire
+    int size();
+
+  private:
+    static void* timerLoop(void* arg);
+    void run();
+
+    // moves the wheel to tick target with the lock held, wakes the due
+    // sleepers and returns the due timers with a target, to be fired once
+    // the lock is released
+    Timer* collect(int64_t target);
+    void fire(Timer* expired);
+
+    TimerId add(simtime_t due, TimerTarget* target, const Event& event, Sleeper* sleeper);
+    void insert(Timer* timer);
+    void cascade(Timer* list);
+    int64_t findNextTick();
+
+    // circular lists, a list is empty when its head points to itself
+    static void append(Timer* list, Timer* timer);
+    static void unlink(Timer* timer);
+    static bool empty(Timer* list);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "trace.hh"
+#include <string.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// fields are separated by spaces and tabs, \r of windows line ends included
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static void skipSpaces(const char* data, size_t& at, size_t end) {
+  while (at < end && isSpace(data[at])) {
+    at++;
+  }
+}
+
+// seconds with up to nine decimals, read straight into nanoseconds so
+// times are exact and the mapping is never read past its end
+static bool readTime(const char* data, size_t& at, size_t end, simtime_t& time) {
+  simtime_t seconds = 0;
+  int digits = 0;
+  while (at < end && isDigit(data[at])) {
+    if (++digits > 9) {
+      return false;
+    }
+    seconds = seconds * 10 + (data[at++] - '0');
+  }
+  simtime_t fraction = 0;
+  simtime_t scale = 1000000000;
+  if (at < end && data[at] == '.') {
+    at++;
+    while (at < end && isDigit(data[at])) {
+      digits++;
+      if (scale > 1) {
+        scale /= 10;
+        fraction += (data[at] - '0') * scale;
+      }
+      at++;
+    }
+  }
+  time = seconds * 1000000000 + fraction;
+  return digits > 0 && (at == end || isSpace(data[at]));
+}
+
+static bool readType(const char* data, size_t& at, size_t end, VoterType& type) {
+  size_t first = at;
+  while (at < end && !isSpace(data[at])) {
+    at++;
+  }
+  for (int t = 0; t < NUM_VOTER_TYPES; t++) {
+    size_t size = strlen(VOTER_TYPE_CODES[t]);
+    if (size == at - first && memcmp(data + first, VOTER_TYPE_CODES[t], size) == 0) {
+      type = (VoterType)t;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool readStation(const char* data, size_t& at, size_t end, int& station) {
+  station = 0;
+  int digits = 0;
+  while (at < end && isDigit(data[at])) {
+    if (++digits > 9) {
+      return false;
+    }
+    station = station * 10 + (data[at++] - '0');
+  }
+  return digits > 0 && (at == end || isSpace(data[at]));
+}
+
+TraceReader::~TraceReader() {
+  if (data != NULL) {
+    munmap((void*)data, length);
+  }
+}
+
+bool TraceReader::open(const std::string& path, std::string& error) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open " + path;
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    error = path + ": no arrivals";
+    return false;
+  }
+  void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    error = "cannot map " + path;
+    return false;
+  }
+  madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+  if (data != NULL) {
+    munmap((void*)data, length);
+  }
+  data = static_cast<const char*>(mapped);
+  length = info.st_size;
+
+  // one pass over the whole trace, so replaying it cannot fail halfway
+  arrivals = 0;
+  end = 0;
+  stations = 0;
+  precision = 0;
+  size_t offset = 0;
+  int lineNumber = 0;
+  while (offset < length) {
+    lineNumber++;
+    TraceArrival arrival;
+    int parsed = parse(offset, arrival);
+    std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+    if (parsed < 0) {
+      error = where + "expected <seconds> <type code> [<station>]";
+      return false;
+    }
+    if (parsed == 0) {
+      continue;
+    }
+    if (arrival.time < end) {
+      error = where + "arrivals are out of order";
+      return false;
+    }
+    end = arrival.time;
+    stations = arrival.station >= stations ? arrival.station + 1 : stations;
+    precision = std::max(precision, tick_precision(arrival.time));
+    arrivals++;
+  }
+  if (arrivals == 0) {
+    error = path + ": no arrivals";
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::next(size_t& offset, TraceArrival& arrival) const {
+  while (offset < length) {
+    if (parse(offset, arrival) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int TraceReader::parse(size_t& offset, TraceArrival& arrival) const {
+  size_t at = offset;
+  const char* newline = static_cast<const char*>(memchr(data + at, '\n', length - at));
+  size_t stop = newline != NULL ? newline - data : length;
+  offset = newline != NULL ? stop + 1 : length;
+  const char* comment = static_cast<const char*>(memchr(data + at, '#', stop - at));
+  stop = comment != NULL ? comment - data : stop;
+
+  skipSpaces(data, at, stop);
+  if (at == stop) {
+    return 0;
+  }
+  if (!readTime(data, at, stop, arrival.time)) {
+    return -1;
+  }
+  skipSpaces(data, at, stop);
+  if (!readType(data, at, stop, arrival.type)) {
+    return -1;
+  }
+  skipSpaces(data, at, stop);
+  arrival.station = -1;
+  if (at < stop && !readStation(data, at, stop, arrival.station)) {
+    return -1;
+  }
+  skipSpaces(data, at, stop);
+  return at == stop ? 1 : -1;
+}
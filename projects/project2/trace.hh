@@ -0,0 +1,73 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+#include <stddef.h>
+#include <string>
+#include "clock.hh"
+#include "voter.hh"
+
+
+ /******************************************************************************
+  recorded arrivals replayed into a virtual-time run
+  a trace is a text file of "<seconds> <type code> [<station>]" lines in
+  order of time, seconds since the polls opened, the type code as in the
+  voter log, the station the voter went to if it is known, blank lines and
+  # comments ignored
+  the file is mapped into memory and checked once when it is opened, runs
+  then stream it line by line from their own offset, so any number of runs
+  can replay one trace at once and a trace of millions of voters costs no
+  more memory than its pages
+  *****************************************************************************/
+
+// station is -1 when the trace does not say where the voter went
+struct TraceArrival {
+  simtime_t time;
+  VoterType type;
+  int station;
+};
+
+class TraceReader {
+  const char* data = NULL;
+  size_t length = 0;
+
+  // what open() found
+  long arrivals = 0;
+  simtime_t end = 0;
+  int stations = 0;
+  int precision = 0;
+
+  public:
+    ~TraceReader();
+
+    // returns false if the file is unusable, error then says why
+    bool open(const std::string& path, std::string& error);
+
+    // the arrival at offset, offset is moved past it, false at the end of
+    // the trace, offsets start at 0
+    bool next(size_t& offset, TraceArrival& arrival) const;
+
+    long size() const {
+      return arrivals;
+    }
+
+    // time of the last arrival
+    simtime_t getEnd() const {
+      return end;
+    }
+
+    // highest station named by the trace plus one
+    int getStations() const {
+      return stations;
+    }
+
+    // decimals needed to print every arrival time, 0 to 9
+    int getPrecision() const {
+      return precision;
+    }
+
+  private:
+    // reads the line at offset and moves offset to the next one, returns 1
+    // for an arrival, 0 for a line without one and -1 if it is malformed
+    int parse(size_t& offset, TraceArrival& arrival) const;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef VOTER_HH
+#define VOTER_HH
+#include <stdint.h>
+#include <string>
+
+#ifndef CANDIDATES_DEF
+#define CANDIDATES_DEF "candidates.def"
+#endif
+
+
+ /******************************************************************************
+  candidate and voter type tables
+  both enums and their metadata are generated from a single definition, the
+  candidates from CANDIDATES_DEF and the voter types from voter_types.def,
+  so lookups are plain array indexing
+  the candidates here make up the built-in ballot, a ballot loaded at run
+  time may have any number of candidates, see ballot.hh
+  *****************************************************************************/
+
+// candidates, an index into the ballot of the run
+enum class Candidate {
+#define CANDIDATE(name, weight) name,
+#include CANDIDATES_DEF
+#undef CANDIDATE
+};
+
+constexpr const char* CANDIDATE_NAMES[] = {
+#define CANDIDATE(name, weight) #name,
+#include CANDIDATES_DEF
+#undef CANDIDATE
+};
+
+constexpr int CANDIDATE_WEIGHTS[] = {
+#define CANDIDATE(name, weight) weight,
+#include CANDIDATES_DEF
+#undef CANDIDATE
+};
+
+const int NUM_CANDIDATES = sizeof(CANDIDATE_WEIGHTS) / sizeof(CANDIDATE_WEIGHTS[0]);
+
+constexpr int sumWeights(int i) {
+  return i == NUM_CANDIDATES ? 0 : CANDIDATE_WEIGHTS[i] + sumWeights(i + 1);
+}
+
+const int TOTAL_CANDIDATE_WEIGHT = sumWeights(0);
+static_assert(TOTAL_CANDIDATE_WEIGHT > 0, "candidate weights must add up to more than zero");
+
+// voter types, in increasing order of priority
+enum class VoterType {
+#define VOTER_TYPE(name, code) name,
+#include "voter_types.def"
+#undef VOTER_TYPE
+};
+
+constexpr const char* VOTER_TYPE_CODES[] = {
+#define VOTER_TYPE(name, code) code,
+#include "voter_types.def"
+#undef VOTER_TYPE
+};
+
+const int NUM_VOTER_TYPES = sizeof(VOTER_TYPE_CODES) / sizeof(VOTER_TYPE_CODES[0]);
+
+// voters are records in the VoterArena, addressed by their index
+typedef uint32_t VoterRef;
+const VoterRef NO_VOTER = UINT32_MAX;
+
+inline std::string getFormattedType(VoterType type) {
+  return VOTER_TYPE_CODES[(int)type];
+}
+
+#endif